@@ -0,0 +1,1339 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include "graphdll.hpp"
+
+#ifdef WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define CG_BENCH_TSC
+#endif
+
+// NOTE: This program times the graphdll entry points on synthetic gradient images and prints
+// one CSV line per case to stdout:
+//
+//   name,format,bits,width,height,iterations,seconds,mpix_per_s,gb_per_s,cycles_per_pixel
+//
+// The seconds column is the best time of one call. The byte rate counts the data that a call
+// has to read and write at the least (file bytes for the file cases, plane bytes for the
+// others), and the cycle counts are time stamp counter ticks (nan where there is no TSC).
+// Entry points that do no per-pixel work (init, shutdown, decode cache configuration and
+// statistics, encoded size queries) are called while setting up the cases but not timed. The
+// stage statistics are timed along with the read they cover, and the context cases run their
+// calls in a context created and bound by the setup function.
+//
+// Usage: bench [scratch_dir [size ...]]
+
+namespace { // begin anonymous namespace
+
+const int DEFAULT_SIZES[] = { 256, 1024, 2048 };
+const int STRIDE_PADDING = 16;
+const int STREAM_ROWS = 16;
+const int DECIMATION = 4;
+const int SSIM_WINDOW = 8;
+const int BLUR_RADIUS = 8;
+const int KERNEL_RADIUS = 3;
+const int COMPARE_TILE = 64;
+
+const double MIN_SECONDS = 0.25;
+const int MIN_ITERATIONS = 3;
+const int MAX_ITERATIONS = 1000;
+
+// Timing
+
+double currentTime() {
+#ifdef WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+#endif
+}
+
+unsigned long long currentCycles() {
+#ifdef CG_BENCH_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// File Descriptors
+
+int openForReading(const char *fileName) {
+#ifdef WIN32
+	return _open(fileName, _O_RDONLY | _O_BINARY);
+#else
+	return open(fileName, O_RDONLY);
+#endif
+}
+
+int openForWriting(const char *fileName) {
+#ifdef WIN32
+	return _open(fileName, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+	return open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+void closeFd(int fd) {
+#ifdef WIN32
+	_close(fd);
+#else
+	close(fd);
+#endif
+}
+
+// Benchmark State
+// NOTE: The double planes hold the gradient pattern from the old cgtest code, the byte planes
+// the same pattern scaled to 0-255. The wide planes are padded by STRIDE_PADDING elements per
+// row for the stride aware variants. Outputs go to the scratch planes.
+struct Bench {
+	int width, height;
+	size_t size, wideSize;
+	int stride;
+	int bits;
+	std::string dir;
+	std::string file, copyFile, outFile, pyramidBase;
+	std::vector<char> encoded;
+	long long encodedSize;
+	int result;
+	
+	std::vector<double> r, g, b, a, h, c, l;
+	std::vector<float> f1, f2;
+	std::vector<uchar> br, bg, bb, ba, bh, bc, bl;
+	std::vector<double> out1, out2, out3, out4;
+	std::vector<float> fout;
+	std::vector<uchar> bout1, bout2, bout3, bout4;
+	std::vector<double> wide1, wide2, wide3, wideOut1, wideOut2, wideOut3;
+	std::vector<uchar> bwide1, bwide2, bwide3, bwide4;
+	std::vector<double> sums, squares;
+	std::vector<long long> bsums, bsquares;
+	std::vector<int> rects;
+	std::vector<double> rectSums, rectMeans, rectVariances;
+	std::vector<uchar> lut, tileMap;
+	std::vector<uchar> indices, paletteR, paletteG, paletteB;
+	std::string scratchFile;
+	cg_context *context;
+	
+	const double *alpha() const { return (bits == 32) ? &a[0] : 0; }
+	const uchar *bytesAlpha() const { return (bits == 32) ? &ba[0] : 0; }
+	double *outAlpha() { return (bits == 32) ? &out4[0] : 0; }
+	uchar *bytesOutAlpha() { return (bits == 32) ? &bout4[0] : 0; }
+	int withAlpha() const { return (bits == 32) ? 1 : 0; }
+	double pixels() const { return (double)size; }
+};
+
+void generateImage(Bench &bench, int width, int height) {
+	bench.width = width;
+	bench.height = height;
+	bench.size = (size_t)width * height;
+	bench.stride = width + STRIDE_PADDING;
+	bench.wideSize = (size_t)bench.stride * height;
+	
+	size_t size = bench.size;
+	bench.r.resize(size); bench.g.resize(size); bench.b.resize(size); bench.a.resize(size);
+	bench.h.resize(size); bench.c.resize(size); bench.l.resize(size);
+	bench.f1.resize(size); bench.f2.resize(size); bench.fout.resize(size);
+	bench.br.resize(size); bench.bg.resize(size); bench.bb.resize(size); bench.ba.resize(size);
+	bench.bh.resize(size); bench.bc.resize(size); bench.bl.resize(size);
+	bench.out1.resize(size); bench.out2.resize(size);
+	bench.out3.resize(size); bench.out4.resize(size);
+	bench.bout1.resize(size); bench.bout2.resize(size);
+	bench.bout3.resize(size); bench.bout4.resize(size);
+	
+	size_t wideSize = bench.wideSize;
+	bench.wide1.resize(wideSize); bench.wide2.resize(wideSize); bench.wide3.resize(wideSize);
+	bench.wideOut1.resize(wideSize); bench.wideOut2.resize(wideSize);
+	bench.wideOut3.resize(wideSize);
+	bench.bwide1.resize(wideSize); bench.bwide2.resize(wideSize);
+	bench.bwide3.resize(wideSize); bench.bwide4.resize(wideSize);
+	
+	size_t tableSize = (size_t)(width + 1) * (height + 1);
+	bench.sums.resize(tableSize); bench.squares.resize(tableSize);
+	bench.bsums.resize(tableSize); bench.bsquares.resize(tableSize);
+	
+	double diagE = std::sqrt((double)width*width + (double)height*height);
+	double diagM = (double)(width + height);
+	
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t i = x + (size_t)width*y;
+			bench.r[i] = std::sqrt((double)x*x + (double)y*y)/diagE;
+			bench.g[i] = (double)((width - x) + y)/diagM;
+			bench.b[i] = (double)(x + (height - y))/diagM;
+			bench.a[i] = (double)((x ^ y) & 0xff)/255.0;
+			
+			bench.br[i] = (uchar)(255.0*bench.r[i] + 0.5);
+			bench.bg[i] = (uchar)(255.0*bench.g[i] + 0.5);
+			bench.bb[i] = (uchar)(255.0*bench.b[i] + 0.5);
+			bench.ba[i] = (uchar)((x ^ y) & 0xff);
+			
+			bench.f1[i] = (float)bench.r[i];
+			bench.f2[i] = (float)bench.g[i];
+			
+			size_t j = x + (size_t)bench.stride*y;
+			bench.wide1[j] = bench.r[i];
+			bench.wide2[j] = bench.g[i];
+			bench.wide3[j] = bench.b[i];
+			bench.bwide1[j] = bench.br[i];
+			bench.bwide2[j] = bench.bg[i];
+			bench.bwide3[j] = bench.bb[i];
+			bench.bwide4[j] = bench.ba[i];
+		}
+	}
+	
+	int res;
+	graphics_convertRGBtoHCL(
+		&width, &height, &bench.r[0], &bench.g[0], &bench.b[0],
+		&bench.h[0], &bench.c[0], &bench.l[0], &res);
+	graphics_convertBytesRGBtoHCL(
+		&width, &height, &bench.br[0], &bench.bg[0], &bench.bb[0],
+		&bench.bh[0], &bench.bc[0], &bench.bl[0], &res);
+	
+	// Rectangles for the integral image queries, one per 16 pixels, from a fixed LCG sequence.
+	int rectCount = (int)(size/16);
+	unsigned int seed = 12345;
+	bench.rects.resize(4*rectCount);
+	bench.rectSums.resize(rectCount);
+	bench.rectMeans.resize(rectCount);
+	bench.rectVariances.resize(rectCount);
+	
+	for (int k = 0; k < rectCount; k++) {
+		int *rect = &bench.rects[4*k];
+		seed = seed*1103515245u + 12345u;
+		rect[0] = (int)((seed >> 8) % (unsigned int)width);
+		seed = seed*1103515245u + 12345u;
+		rect[1] = (int)((seed >> 8) % (unsigned int)height);
+		seed = seed*1103515245u + 12345u;
+		rect[2] = 1 + (int)((seed >> 8) % (unsigned int)(width - rect[0]));
+		seed = seed*1103515245u + 12345u;
+		rect[3] = 1 + (int)((seed >> 8) % (unsigned int)(height - rect[1]));
+	}
+	
+	bench.lut.resize(256);
+	for (int i = 0; i < 256; i++)
+		bench.lut[i] = (uchar)(255 - i);
+	
+	// NOTE: The indexed-color image uses a 3-3-2 bit palette of the byte planes.
+	bench.indices.resize(size);
+	for (size_t i = 0; i < size; i++) {
+		int index = (bench.br[i] & 0xe0) | ((bench.bg[i] >> 3) & 0x1c) | (bench.bb[i] >> 6);
+		bench.indices[i] = (uchar)index;
+	}
+	
+	bench.paletteR.resize(256); bench.paletteG.resize(256); bench.paletteB.resize(256);
+	for (int i = 0; i < 256; i++) {
+		bench.paletteR[i] = (uchar)((i >> 5)*255/7);
+		bench.paletteG[i] = (uchar)(((i >> 2) & 7)*255/7);
+		bench.paletteB[i] = (uchar)((i & 3)*255/3);
+	}
+}
+
+// Prepares the image file, its copy and its in-memory encoding for the given bit depth.
+int prepareFiles(Bench &bench, int bits) {
+	char name[64];
+	int res;
+	
+	bench.bits = bits;
+	std::sprintf(name, "/bench_%d", bits);
+	bench.file = bench.dir + name + ".bmp";
+	bench.copyFile = bench.dir + name + "_copy.bmp";
+	bench.outFile = bench.dir + name + "_out.bmp";
+	bench.pyramidBase = bench.dir + name + "_level";
+	
+	for (int k = 0; k < 2; k++) {
+		graphics_writeImageBytesRGB(
+			(k == 0) ? bench.file.c_str() : bench.copyFile.c_str(), "bmp",
+			&bench.width, &bench.height,
+			&bench.br[0], &bench.bg[0], &bench.bb[0], bench.bytesAlpha(), &res);
+		if (res != CGRESULT_OK)
+			return res;
+	}
+	
+	int withAlpha = bench.withAlpha();
+	long long capacity;
+	graphics_getEncodedImageSize(
+		"bmp", &bench.width, &bench.height, &withAlpha, &capacity, &res);
+	if (res != CGRESULT_OK)
+		return res;
+	
+	bench.encoded.resize((size_t)capacity);
+	graphics_encodeImageBytesRGB(
+		"bmp", &bench.width, &bench.height,
+		&bench.br[0], &bench.bg[0], &bench.bb[0], bench.bytesAlpha(),
+		&bench.encoded[0], &capacity, &bench.encodedSize, &res);
+	
+	return res;
+}
+
+void removeFiles(Bench &bench) {
+	std::remove(bench.file.c_str());
+	std::remove(bench.copyFile.c_str());
+	std::remove(bench.outFile.c_str());
+	
+	for (int k = 1; k < 32; k++) {
+		char suffix[16];
+		std::sprintf(suffix, "_%d.bmp", k);
+		std::remove((bench.pyramidBase + suffix).c_str());
+	}
+}
+
+// Benchmark Cases
+// NOTE: Each case function makes one call (or one complete sequence of calls for the streaming
+// and file descriptor APIs), stores the result code and returns the number of pixels processed.
+
+typedef double (*CaseFunction)(Bench &bench);
+typedef void (*SetupFunction)(Bench &bench);
+
+struct BenchCase {
+	const char *name;
+	const char *format;
+	bool fileCase;          // Run once per file bit depth.
+	double bytesPerPixel;   // Plane bytes read and written per pixel.
+	double filePasses;      // File bytes read or written per pixel, in units of bits/8.
+	CaseFunction run;
+	SetupFunction setup;
+	SetupFunction teardown;
+};
+
+// Conversion
+
+double convertRGBtoHCL(Bench &bench) {
+	graphics_convertRGBtoHCL(
+		&bench.width, &bench.height, &bench.r[0], &bench.g[0], &bench.b[0],
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], &bench.result);
+	return bench.pixels();
+}
+
+double convertRGBtoLuma(Bench &bench) {
+	graphics_convertRGBtoHCL(
+		&bench.width, &bench.height, &bench.r[0], &bench.g[0], &bench.b[0],
+		0, 0, &bench.out3[0], &bench.result);
+	return bench.pixels();
+}
+
+double convertHCLtoRGB(Bench &bench) {
+	graphics_convertHCLtoRGB(
+		&bench.width, &bench.height, &bench.h[0], &bench.c[0], &bench.l[0],
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], &bench.result);
+	return bench.pixels();
+}
+
+double convertBytesRGBtoHCL(Bench &bench) {
+	graphics_convertBytesRGBtoHCL(
+		&bench.width, &bench.height, &bench.br[0], &bench.bg[0], &bench.bb[0],
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], &bench.result);
+	return bench.pixels();
+}
+
+double convertBytesHCLtoRGB(Bench &bench) {
+	graphics_convertBytesHCLtoRGB(
+		&bench.width, &bench.height, &bench.bh[0], &bench.bc[0], &bench.bl[0],
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], &bench.result);
+	return bench.pixels();
+}
+
+double convertRGBtoHCLEx(Bench &bench) {
+	graphics_convertRGBtoHCLEx(
+		&bench.width, &bench.height,
+		&bench.stride, &bench.wide1[0], &bench.wide2[0], &bench.wide3[0],
+		&bench.stride, &bench.wideOut1[0], &bench.wideOut2[0], &bench.wideOut3[0],
+		&bench.result);
+	return bench.pixels();
+}
+
+double convertHCLtoRGBEx(Bench &bench) {
+	// The RGB gradient is valid (if odd) HCL input as well.
+	graphics_convertHCLtoRGBEx(
+		&bench.width, &bench.height,
+		&bench.stride, &bench.wide1[0], &bench.wide2[0], &bench.wide3[0],
+		&bench.stride, &bench.wideOut1[0], &bench.wideOut2[0], &bench.wideOut3[0],
+		&bench.result);
+	return bench.pixels();
+}
+
+double convertBytesRGBtoHCLEx(Bench &bench) {
+	graphics_convertBytesRGBtoHCLEx(
+		&bench.width, &bench.height,
+		&bench.stride, &bench.bwide1[0], &bench.bwide2[0], &bench.bwide3[0],
+		&bench.width, &bench.bout1[0], &bench.bout2[0], &bench.bout3[0],
+		&bench.result);
+	return bench.pixels();
+}
+
+double convertBytesHCLtoRGBEx(Bench &bench) {
+	graphics_convertBytesHCLtoRGBEx(
+		&bench.width, &bench.height,
+		&bench.width, &bench.bh[0], &bench.bc[0], &bench.bl[0],
+		&bench.stride, &bench.bwide1[0], &bench.bwide2[0], &bench.bwide3[0],
+		&bench.result);
+	return bench.pixels();
+}
+
+// File Reading and Writing
+
+double readImageRGB(Bench &bench) {
+	int w, h;
+	graphics_readImageRGB(
+		bench.file.c_str(), "bmp", &bench.width, &bench.height, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double readImageHCL(Bench &bench) {
+	int w, h;
+	graphics_readImageHCL(
+		bench.file.c_str(), "bmp", &bench.width, &bench.height, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double readImageBytesRGB(Bench &bench) {
+	int w, h;
+	graphics_readImageBytesRGB(
+		bench.file.c_str(), "bmp", &bench.width, &bench.height, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return bench.pixels();
+}
+
+double readImageBytesHCL(Bench &bench) {
+	int w, h;
+	graphics_readImageBytesHCL(
+		bench.file.c_str(), "bmp", &bench.width, &bench.height, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return bench.pixels();
+}
+
+double readImageBytesRGBStats(Bench &bench) {
+	long long counts[CG_STAT_COUNT], nanoseconds[CG_STAT_COUNT];
+	int res;
+	graphics_resetStats(&res);
+	readImageBytesRGB(bench);
+	graphics_getStats(counts, nanoseconds, 0, 0, &res);
+	if (bench.result == CGRESULT_OK)
+		bench.result = res;
+	return bench.pixels();
+}
+
+double writeImageRGB(Bench &bench) {
+	graphics_writeImageRGB(
+		bench.outFile.c_str(), "bmp", &bench.width, &bench.height,
+		&bench.r[0], &bench.g[0], &bench.b[0], bench.alpha(), &bench.result);
+	return bench.pixels();
+}
+
+double writeImageHCL(Bench &bench) {
+	graphics_writeImageHCL(
+		bench.outFile.c_str(), "bmp", &bench.width, &bench.height,
+		&bench.h[0], &bench.c[0], &bench.l[0], bench.alpha(), &bench.result);
+	return bench.pixels();
+}
+
+double writeImageBytesRGB(Bench &bench) {
+	graphics_writeImageBytesRGB(
+		bench.outFile.c_str(), "bmp", &bench.width, &bench.height,
+		&bench.br[0], &bench.bg[0], &bench.bb[0], bench.bytesAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double writeImageBytesHCL(Bench &bench) {
+	graphics_writeImageBytesHCL(
+		bench.outFile.c_str(), "bmp", &bench.width, &bench.height,
+		&bench.bh[0], &bench.bc[0], &bench.bl[0], bench.bytesAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double readImageEx(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = CG_FLAG_TOP_DOWN;
+	int w, h;
+	graphics_readImageEx(
+		bench.file.c_str(), "bmp", &dataFormat, &bench.width, &bench.height,
+		&bench.stride, &flags, &w, &h,
+		&bench.bwide1[0], &bench.bwide2[0], &bench.bwide3[0],
+		(bench.bits == 32) ? &bench.bwide4[0] : 0, &bench.result);
+	return bench.pixels();
+}
+
+double writeImageEx(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = CG_FLAG_TOP_DOWN;
+	graphics_writeImageEx(
+		bench.outFile.c_str(), "bmp", &dataFormat, &bench.width, &bench.height,
+		&bench.stride, &flags,
+		&bench.bwide1[0], &bench.bwide2[0], &bench.bwide3[0],
+		(bench.bits == 32) ? &bench.bwide4[0] : 0, &bench.result);
+	return bench.pixels();
+}
+
+// Region and Decimated Reads
+// NOTE: The regions are the central quarter of the image.
+
+double readImageRegionRGB(Bench &bench) {
+	int x = bench.width/4, y = bench.height/4, w = bench.width/2, h = bench.height/2;
+	graphics_readImageRegionRGB(
+		bench.file.c_str(), "bmp", &x, &y, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return (double)w * h;
+}
+
+double readImageRegionHCL(Bench &bench) {
+	int x = bench.width/4, y = bench.height/4, w = bench.width/2, h = bench.height/2;
+	graphics_readImageRegionHCL(
+		bench.file.c_str(), "bmp", &x, &y, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return (double)w * h;
+}
+
+double readImageRegionBytesRGB(Bench &bench) {
+	int x = bench.width/4, y = bench.height/4, w = bench.width/2, h = bench.height/2;
+	graphics_readImageRegionBytesRGB(
+		bench.file.c_str(), "bmp", &x, &y, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return (double)w * h;
+}
+
+double readImageRegionBytesHCL(Bench &bench) {
+	int x = bench.width/4, y = bench.height/4, w = bench.width/2, h = bench.height/2;
+	graphics_readImageRegionBytesHCL(
+		bench.file.c_str(), "bmp", &x, &y, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return (double)w * h;
+}
+
+double readImageRegionEx(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = CG_FLAG_TOP_DOWN;
+	int x = bench.width/4, y = bench.height/4, w = bench.width/2, h = bench.height/2;
+	graphics_readImageRegionEx(
+		bench.file.c_str(), "bmp", &dataFormat, &x, &y, &w, &h, &bench.stride, &flags,
+		&bench.bwide1[0], &bench.bwide2[0], &bench.bwide3[0],
+		(bench.bits == 32) ? &bench.bwide4[0] : 0, &bench.result);
+	return (double)w * h;
+}
+
+double readImageDecimatedRGB(Bench &bench) {
+	int factor = DECIMATION, w, h;
+	graphics_readImageDecimatedRGB(
+		bench.file.c_str(), "bmp", &factor, &bench.width, &bench.height, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double readImageDecimatedHCL(Bench &bench) {
+	int factor = DECIMATION, w, h;
+	graphics_readImageDecimatedHCL(
+		bench.file.c_str(), "bmp", &factor, &bench.width, &bench.height, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double readImageDecimatedBytesRGB(Bench &bench) {
+	int factor = DECIMATION, w, h;
+	graphics_readImageDecimatedBytesRGB(
+		bench.file.c_str(), "bmp", &factor, &bench.width, &bench.height, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return bench.pixels();
+}
+
+double readImageDecimatedBytesHCL(Bench &bench) {
+	int factor = DECIMATION, w, h;
+	graphics_readImageDecimatedBytesHCL(
+		bench.file.c_str(), "bmp", &factor, &bench.width, &bench.height, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return bench.pixels();
+}
+
+// In-Memory Decoding and Encoding
+
+double decodeImageRGB(Bench &bench) {
+	int w, h;
+	graphics_decodeImageRGB(
+		&bench.encoded[0], &bench.encodedSize, &bench.width, &bench.height, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double decodeImageHCL(Bench &bench) {
+	int w, h;
+	graphics_decodeImageHCL(
+		&bench.encoded[0], &bench.encodedSize, &bench.width, &bench.height, &w, &h,
+		&bench.out1[0], &bench.out2[0], &bench.out3[0], bench.outAlpha(), &bench.result);
+	return bench.pixels();
+}
+
+double decodeImageBytesRGB(Bench &bench) {
+	int w, h;
+	graphics_decodeImageBytesRGB(
+		&bench.encoded[0], &bench.encodedSize, &bench.width, &bench.height, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return bench.pixels();
+}
+
+double decodeImageBytesHCL(Bench &bench) {
+	int w, h;
+	graphics_decodeImageBytesHCL(
+		&bench.encoded[0], &bench.encodedSize, &bench.width, &bench.height, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	return bench.pixels();
+}
+
+double decodeImageEx(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = CG_FLAG_TOP_DOWN;
+	int w, h;
+	graphics_decodeImageEx(
+		&bench.encoded[0], &bench.encodedSize, &dataFormat, &bench.width, &bench.height,
+		&bench.stride, &flags, &w, &h,
+		&bench.bwide1[0], &bench.bwide2[0], &bench.bwide3[0],
+		(bench.bits == 32) ? &bench.bwide4[0] : 0, &bench.result);
+	return bench.pixels();
+}
+
+double encodeImageRGB(Bench &bench) {
+	long long capacity = (long long)bench.encoded.size(), size;
+	graphics_encodeImageRGB(
+		"bmp", &bench.width, &bench.height,
+		&bench.r[0], &bench.g[0], &bench.b[0], bench.alpha(),
+		&bench.encoded[0], &capacity, &size, &bench.result);
+	return bench.pixels();
+}
+
+double encodeImageHCL(Bench &bench) {
+	long long capacity = (long long)bench.encoded.size(), size;
+	graphics_encodeImageHCL(
+		"bmp", &bench.width, &bench.height,
+		&bench.h[0], &bench.c[0], &bench.l[0], bench.alpha(),
+		&bench.encoded[0], &capacity, &size, &bench.result);
+	return bench.pixels();
+}
+
+double encodeImageBytesRGB(Bench &bench) {
+	long long capacity = (long long)bench.encoded.size(), size;
+	graphics_encodeImageBytesRGB(
+		"bmp", &bench.width, &bench.height,
+		&bench.br[0], &bench.bg[0], &bench.bb[0], bench.bytesAlpha(),
+		&bench.encoded[0], &capacity, &size, &bench.result);
+	return bench.pixels();
+}
+
+double encodeImageBytesHCL(Bench &bench) {
+	long long capacity = (long long)bench.encoded.size(), size;
+	graphics_encodeImageBytesHCL(
+		"bmp", &bench.width, &bench.height,
+		&bench.bh[0], &bench.bc[0], &bench.bl[0], bench.bytesAlpha(),
+		&bench.encoded[0], &capacity, &size, &bench.result);
+	return bench.pixels();
+}
+
+double encodeImageEx(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = CG_FLAG_TOP_DOWN;
+	long long capacity = (long long)bench.encoded.size(), size;
+	graphics_encodeImageEx(
+		"bmp", &dataFormat, &bench.width, &bench.height, &bench.stride, &flags,
+		&bench.bwide1[0], &bench.bwide2[0], &bench.bwide3[0],
+		(bench.bits == 32) ? &bench.bwide4[0] : 0,
+		&bench.encoded[0], &capacity, &size, &bench.result);
+	return bench.pixels();
+}
+
+// File Descriptors and Streaming
+
+double readImageFd(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = 0;
+	int fd = openForReading(bench.file.c_str());
+	int w, h;
+	
+	if (fd < 0) {
+		bench.result = CGRESULT_FOPEN_FAILED;
+		return 0.0;
+	}
+	
+	graphics_readImageFd(
+		&fd, &dataFormat, &bench.width, &bench.height, &bench.width, &flags, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], bench.bytesOutAlpha(),
+		&bench.result);
+	closeFd(fd);
+	return bench.pixels();
+}
+
+double writeImageFd(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = 0;
+	int fd = openForWriting(bench.outFile.c_str());
+	
+	if (fd < 0) {
+		bench.result = CGRESULT_FOPEN_FAILED;
+		return 0.0;
+	}
+	
+	graphics_writeImageFd(
+		&fd, "bmp", &dataFormat, &bench.width, &bench.height, &bench.width, &flags,
+		&bench.br[0], &bench.bg[0], &bench.bb[0], bench.bytesAlpha(), &bench.result);
+	closeFd(fd);
+	return bench.pixels();
+}
+
+double readRows(Bench &bench, const std::string &file) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES;
+	cg_image_reader *reader = 0;
+	int w, h, closeRes;
+	
+	graphics_openImageReader(
+		file.c_str(), "bmp", &dataFormat, &bench.width, &bench.height,
+		&reader, &w, &h, &bench.result);
+	if (bench.result != CGRESULT_OK)
+		return 0.0;
+	
+	for (int y = 0; y < h && bench.result == CGRESULT_OK; y += STREAM_ROWS) {
+		int rows = (h - y < STREAM_ROWS) ? h - y : STREAM_ROWS;
+		graphics_readImageRows(
+			reader, &rows, &bench.bout1[0], &bench.bout2[0], &bench.bout3[0],
+			bench.bytesOutAlpha(), &bench.result);
+	}
+	
+	graphics_closeImageReader(reader, &closeRes);
+	if (bench.result == CGRESULT_OK)
+		bench.result = closeRes;
+	return bench.pixels();
+}
+
+double readImageRows(Bench &bench) {
+	return readRows(bench, bench.file);
+}
+
+double writeImageRows(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, withAlpha = bench.withAlpha();
+	cg_image_writer *writer = 0;
+	int closeRes;
+	
+	graphics_openImageWriter(
+		bench.outFile.c_str(), "bmp", &dataFormat, &bench.width, &bench.height, &withAlpha,
+		&writer, &bench.result);
+	if (bench.result != CGRESULT_OK)
+		return 0.0;
+	
+	for (int y = 0; y < bench.height && bench.result == CGRESULT_OK; y += STREAM_ROWS) {
+		int rows = (bench.height - y < STREAM_ROWS) ? bench.height - y : STREAM_ROWS;
+		size_t offset = (size_t)bench.width * y;
+		graphics_writeImageRows(
+			writer, &rows, &bench.br[offset], &bench.bg[offset], &bench.bb[offset],
+			(withAlpha) ? &bench.ba[offset] : 0, &bench.result);
+	}
+	
+	graphics_closeImageWriter(writer, &closeRes);
+	if (bench.result == CGRESULT_OK)
+		bench.result = closeRes;
+	return bench.pixels();
+}
+
+// Whole-File Operations
+
+double compareImageFiles(Bench &bench) {
+	int tileSize = COMPARE_TILE, maxTiles = (int)bench.tileMap.size();
+	int equal, tilesX, tilesY;
+	graphics_compareImageFiles(
+		bench.file.c_str(), bench.copyFile.c_str(), "bmp", &tileSize, &tileSize, &maxTiles,
+		&equal, &tilesX, &tilesY, &bench.tileMap[0], &bench.result);
+	return bench.pixels();
+}
+
+void setupCompare(Bench &bench) {
+	size_t tilesX = (bench.width + COMPARE_TILE - 1) / COMPARE_TILE;
+	size_t tilesY = (bench.height + COMPARE_TILE - 1) / COMPARE_TILE;
+	bench.tileMap.resize(tilesX * tilesY);
+}
+
+double buildImagePyramid(Bench &bench) {
+	int maxLevels = 0, withAlpha = bench.withAlpha(), levels;
+	graphics_buildImagePyramid(
+		bench.file.c_str(), "bmp", bench.pyramidBase.c_str(), "bmp", &maxLevels, &withAlpha,
+		&levels, &bench.result);
+	return bench.pixels();
+}
+
+// NOTE: The cached case measures hits only. The cache is filled by the warm-up call.
+void enableDecodeCache(Bench &) {
+	long long budget = 1LL << 30;
+	int res;
+	graphics_configureDecodeCache(&budget, &res);
+}
+
+void disableDecodeCache(Bench &) {
+	long long budget = 0, hits, misses, bytes;
+	int entries, res;
+	graphics_getDecodeCacheStats(&hits, &misses, &bytes, &entries, &res);
+	graphics_configureDecodeCache(&budget, &res);
+}
+
+// Indexed-Color and Bit Field Images
+// NOTE: These images are written by the setup functions in the scratch directory, since their
+// bit depth does not follow the file cases. Their byte counts include the file bytes.
+
+double readScratchImage(Bench &bench) {
+	int w, h;
+	graphics_readImageBytesRGB(
+		bench.scratchFile.c_str(), "bmp", &bench.width, &bench.height, &w, &h,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], 0, &bench.result);
+	return bench.pixels();
+}
+
+double readScratchImageRows(Bench &bench) {
+	return readRows(bench, bench.scratchFile);
+}
+
+void nameIndexedFile(Bench &bench) {
+	bench.scratchFile = bench.dir + "/bench_indexed.bmp";
+}
+
+void writeIndexedFile(Bench &bench, int flags) {
+	int paletteSize = 256;
+	nameIndexedFile(bench);
+	graphics_writeIndexedImage(
+		bench.scratchFile.c_str(), "bmp", &bench.width, &bench.height, &bench.width, &flags,
+		&bench.indices[0], &paletteSize,
+		&bench.paletteR[0], &bench.paletteG[0], &bench.paletteB[0], &bench.result);
+}
+
+void setupIndexed(Bench &bench) {
+	writeIndexedFile(bench, 0);
+}
+
+void setupRLE(Bench &bench) {
+	writeIndexedFile(bench, CG_FLAG_RLE);
+}
+
+double writeIndexedImage(Bench &bench) {
+	writeIndexedFile(bench, 0);
+	return bench.pixels();
+}
+
+double writeIndexedImageRLE(Bench &bench) {
+	writeIndexedFile(bench, CG_FLAG_RLE);
+	return bench.pixels();
+}
+
+// NOTE: The palette is chosen for the image on each call, so this case times the quantization
+// as well as the write.
+double writeImageExIndexed(Bench &bench) {
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES, flags = CG_FLAG_INDEXED;
+	graphics_writeImageEx(
+		bench.scratchFile.c_str(), "bmp", &dataFormat, &bench.width, &bench.height,
+		&bench.width, &flags, &bench.br[0], &bench.bg[0], &bench.bb[0], 0, &bench.result);
+	return bench.pixels();
+}
+
+void removeScratchFile(Bench &bench) {
+	std::remove(bench.scratchFile.c_str());
+}
+
+// NOTE: No entry point writes bit field images, so the RGB565 file is put together here, with
+// a BITMAPINFOHEADER followed by the three masks.
+void putLittleEndian(std::vector<uchar> &data, unsigned int value, int bytes) {
+	for (int k = 0; k < bytes; k++)
+		data.push_back((uchar)(value >> 8*k));
+}
+
+void setupBitfields(Bench &bench) {
+	const unsigned int headerSize = 14 + 40 + 12;
+	unsigned int rowBytes = (2*bench.width + 3) & ~3U;
+	unsigned int bitmapSize = rowBytes * bench.height;
+	std::vector<uchar> data;
+	
+	putLittleEndian(data, 0x4d42, 2);
+	putLittleEndian(data, headerSize + bitmapSize, 4);
+	putLittleEndian(data, 0, 4);
+	putLittleEndian(data, headerSize, 4);
+	
+	putLittleEndian(data, 40, 4);
+	putLittleEndian(data, bench.width, 4);
+	putLittleEndian(data, bench.height, 4);
+	putLittleEndian(data, 1, 2);
+	putLittleEndian(data, 16, 2);
+	putLittleEndian(data, 3, 4);     // BI_BITFIELDS
+	putLittleEndian(data, bitmapSize, 4);
+	putLittleEndian(data, 2835, 4);
+	putLittleEndian(data, 2835, 4);
+	putLittleEndian(data, 0, 4);
+	putLittleEndian(data, 0, 4);
+	
+	putLittleEndian(data, 0xf800, 4);
+	putLittleEndian(data, 0x07e0, 4);
+	putLittleEndian(data, 0x001f, 4);
+	
+	for (int y = 0; y < bench.height; y++) {
+		for (int x = 0; x < bench.width; x++) {
+			size_t i = x + (size_t)bench.width*y;
+			unsigned int pixel =
+				((bench.br[i] >> 3) << 11) | ((bench.bg[i] >> 2) << 5) | (bench.bb[i] >> 3);
+			putLittleEndian(data, pixel, 2);
+		}
+		data.resize(headerSize + rowBytes*(y + 1), 0);
+	}
+	
+	bench.scratchFile = bench.dir + "/bench_bitfields.bmp";
+	FILE *file = std::fopen(bench.scratchFile.c_str(), "wb");
+	if (file) {
+		std::fwrite(&data[0], 1, data.size(), file);
+		std::fclose(file);
+	}
+}
+
+// Pixel Operations
+
+double applyLUT8(Bench &bench) {
+	const uchar *lut = &bench.lut[0];
+	graphics_applyLUT8(
+		&bench.width, &bench.height, lut, lut, lut, 0,
+		&bench.br[0], &bench.bg[0], &bench.bb[0], 0,
+		&bench.bout1[0], &bench.bout2[0], &bench.bout3[0], 0, &bench.result);
+	return bench.pixels();
+}
+
+double measureDifference(Bench &bench) {
+	int window = SSIM_WINDOW;
+	double metrics[CG_METRIC_COUNT];
+	graphics_measureDifference(
+		&bench.width, &bench.height, &bench.r[0], &bench.g[0], &window, metrics,
+		&bench.result);
+	return bench.pixels();
+}
+
+double measureDifferenceFloat(Bench &bench) {
+	int window = SSIM_WINDOW;
+	double metrics[CG_METRIC_COUNT];
+	graphics_measureDifferenceFloat(
+		&bench.width, &bench.height, &bench.f1[0], &bench.f2[0], &window, metrics,
+		&bench.result);
+	return bench.pixels();
+}
+
+double measureDifferenceBytes(Bench &bench) {
+	int window = SSIM_WINDOW;
+	double metrics[CG_METRIC_COUNT];
+	graphics_measureDifferenceBytes(
+		&bench.width, &bench.height, &bench.br[0], &bench.bg[0], &window, metrics,
+		&bench.result);
+	return bench.pixels();
+}
+
+// NOTE: The resampling cases halve the image with the Lanczos filter, so the pixel counts
+// are source pixels.
+
+double resample(Bench &bench) {
+	int dstWidth = bench.width/2, dstHeight = bench.height/2, filter = CG_FILTER_LANCZOS3;
+	graphics_resample(
+		&bench.width, &bench.height, &bench.r[0], &dstWidth, &dstHeight, &bench.out1[0],
+		&filter, &bench.result);
+	return bench.pixels();
+}
+
+double resampleFloat(Bench &bench) {
+	int dstWidth = bench.width/2, dstHeight = bench.height/2, filter = CG_FILTER_LANCZOS3;
+	graphics_resampleFloat(
+		&bench.width, &bench.height, &bench.f1[0], &dstWidth, &dstHeight, &bench.fout[0],
+		&filter, &bench.result);
+	return bench.pixels();
+}
+
+double resampleBytes(Bench &bench) {
+	int dstWidth = bench.width/2, dstHeight = bench.height/2, filter = CG_FILTER_LANCZOS3;
+	graphics_resampleBytes(
+		&bench.width, &bench.height, &bench.br[0], &dstWidth, &dstHeight, &bench.bout1[0],
+		&filter, &bench.result);
+	return bench.pixels();
+}
+
+// NOTE: The filters work in place on the scratch planes, which are refilled from the source
+// planes by the setup function. Repeated filtering keeps the values in range.
+
+void copySourcePlanes(Bench &bench) {
+	std::memcpy(&bench.out1[0], &bench.r[0], bench.size * sizeof(double));
+	std::memcpy(&bench.bout1[0], &bench.br[0], bench.size);
+}
+
+double convolve(Bench &bench) {
+	const double kernel[2*KERNEL_RADIUS + 1] = {
+		1.0/64.0, 6.0/64.0, 15.0/64.0, 20.0/64.0, 15.0/64.0, 6.0/64.0, 1.0/64.0
+	};
+	int radius = KERNEL_RADIUS;
+	graphics_convolve(
+		&bench.width, &bench.height, &bench.out1[0], kernel, &radius, kernel, &radius,
+		&bench.result);
+	return bench.pixels();
+}
+
+double convolveBytes(Bench &bench) {
+	const double kernel[2*KERNEL_RADIUS + 1] = {
+		1.0/64.0, 6.0/64.0, 15.0/64.0, 20.0/64.0, 15.0/64.0, 6.0/64.0, 1.0/64.0
+	};
+	int radius = KERNEL_RADIUS;
+	graphics_convolveBytes(
+		&bench.width, &bench.height, &bench.bout1[0], kernel, &radius, kernel, &radius,
+		&bench.result);
+	return bench.pixels();
+}
+
+double boxBlur(Bench &bench) {
+	int radius = BLUR_RADIUS;
+	graphics_boxBlur(
+		&bench.width, &bench.height, &bench.out1[0], &radius, &radius, &bench.result);
+	return bench.pixels();
+}
+
+double boxBlurBytes(Bench &bench) {
+	int radius = BLUR_RADIUS;
+	graphics_boxBlurBytes(
+		&bench.width, &bench.height, &bench.bout1[0], &radius, &radius, &bench.result);
+	return bench.pixels();
+}
+
+double gaussianBlur(Bench &bench) {
+	double sigma = 0.5*BLUR_RADIUS;
+	graphics_gaussianBlur(
+		&bench.width, &bench.height, &bench.out1[0], &sigma, &sigma, &bench.result);
+	return bench.pixels();
+}
+
+double gaussianBlurBytes(Bench &bench) {
+	double sigma = 0.5*BLUR_RADIUS;
+	graphics_gaussianBlurBytes(
+		&bench.width, &bench.height, &bench.bout1[0], &sigma, &sigma, &bench.result);
+	return bench.pixels();
+}
+
+// Contexts
+// NOTE: A bound context lends its scratch buffers to the codec, and gives the parallel pixel
+// operations their thread count.
+
+void bindBenchContext(Bench &bench) {
+	int maxThreads = 0, res;
+	bench.context = 0;
+	graphics_createContext(&maxThreads, &bench.context, &res);
+	if (res == CGRESULT_OK)
+		graphics_bindContext(bench.context, &res);
+}
+
+void unbindBenchContext(Bench &bench) {
+	int res;
+	graphics_bindContext(0, &res);
+	graphics_destroyContext(bench.context, &res);
+}
+
+void setupContextBlur(Bench &bench) {
+	copySourcePlanes(bench);
+	bindBenchContext(bench);
+}
+
+// Integral Images
+// NOTE: The query cases count rectangles rather than pixels.
+
+double buildIntegralImage(Bench &bench) {
+	graphics_buildIntegralImage(
+		&bench.width, &bench.height, &bench.l[0], &bench.sums[0], &bench.squares[0],
+		&bench.result);
+	return bench.pixels();
+}
+
+double buildIntegralImageBytes(Bench &bench) {
+	graphics_buildIntegralImageBytes(
+		&bench.width, &bench.height, &bench.bl[0], &bench.bsums[0], &bench.bsquares[0],
+		&bench.result);
+	return bench.pixels();
+}
+
+double queryIntegralImage(Bench &bench) {
+	int rectCount = (int)bench.rectSums.size();
+	graphics_queryIntegralImage(
+		&bench.width, &bench.height, &bench.sums[0], &bench.squares[0],
+		&rectCount, &bench.rects[0],
+		&bench.rectSums[0], &bench.rectMeans[0], &bench.rectVariances[0], &bench.result);
+	return (double)rectCount;
+}
+
+double queryIntegralImageBytes(Bench &bench) {
+	int rectCount = (int)bench.rectSums.size();
+	graphics_queryIntegralImageBytes(
+		&bench.width, &bench.height, &bench.bsums[0], &bench.bsquares[0],
+		&rectCount, &bench.rects[0],
+		&bench.rectSums[0], &bench.rectMeans[0], &bench.rectVariances[0], &bench.result);
+	return (double)rectCount;
+}
+
+void buildIntegralTables(Bench &bench) {
+	buildIntegralImage(bench);
+	buildIntegralImageBytes(bench);
+}
+
+// Case Table
+// NOTE: The byte counts are the minimum traffic of one pixel: planes read plus planes written,
+// plus the file or encoded data in units of the file's bytes per pixel.
+
+const BenchCase CASES[] = {
+	{ "convertRGBtoHCL", "rgb", false, 48.0, 0.0, convertRGBtoHCL, 0, 0 },
+	{ "convertRGBtoHCL/luma", "rgb", false, 32.0, 0.0, convertRGBtoLuma, 0, 0 },
+	{ "convertHCLtoRGB", "hcl", false, 48.0, 0.0, convertHCLtoRGB, 0, 0 },
+	{ "convertBytesRGBtoHCL", "rgb8", false, 6.0, 0.0, convertBytesRGBtoHCL, 0, 0 },
+	{ "convertBytesHCLtoRGB", "hcl8", false, 6.0, 0.0, convertBytesHCLtoRGB, 0, 0 },
+	{ "convertRGBtoHCLEx", "rgb", false, 48.0, 0.0, convertRGBtoHCLEx, 0, 0 },
+	{ "convertHCLtoRGBEx", "hcl", false, 48.0, 0.0, convertHCLtoRGBEx, 0, 0 },
+	{ "convertBytesRGBtoHCLEx", "rgb8", false, 6.0, 0.0, convertBytesRGBtoHCLEx, 0, 0 },
+	{ "convertBytesHCLtoRGBEx", "hcl8", false, 6.0, 0.0, convertBytesHCLtoRGBEx, 0, 0 },
+	
+	{ "readImageRGB", "rgb", true, 32.0, 1.0, readImageRGB, 0, 0 },
+	{ "readImageHCL", "hcl", true, 32.0, 1.0, readImageHCL, 0, 0 },
+	{ "readImageBytesRGB", "rgb8", true, 4.0, 1.0, readImageBytesRGB, 0, 0 },
+	{ "readImageBytesHCL", "hcl8", true, 4.0, 1.0, readImageBytesHCL, 0, 0 },
+	{ "readImageBytesRGB/stats", "rgb8", true, 4.0, 1.0, readImageBytesRGBStats, 0, 0 },
+	{ "readImageBytesRGB/context", "rgb8", true, 4.0, 1.0, readImageBytesRGB,
+		bindBenchContext, unbindBenchContext },
+	{ "readImageRows/context", "rgb8", true, 4.0, 1.0, readImageRows,
+		bindBenchContext, unbindBenchContext },
+	{ "readImageRGB/cached", "rgb", true, 32.0, 0.0, readImageRGB,
+		enableDecodeCache, disableDecodeCache },
+	{ "readImageBytesRGB/cached", "rgb8", true, 4.0, 0.0, readImageBytesRGB,
+		enableDecodeCache, disableDecodeCache },
+	{ "writeImageRGB", "rgb", true, 32.0, 1.0, writeImageRGB, 0, 0 },
+	{ "writeImageHCL", "hcl", true, 32.0, 1.0, writeImageHCL, 0, 0 },
+	{ "writeImageBytesRGB", "rgb8", true, 4.0, 1.0, writeImageBytesRGB, 0, 0 },
+	{ "writeImageBytesHCL", "hcl8", true, 4.0, 1.0, writeImageBytesHCL, 0, 0 },
+	{ "readImageEx", "rgb8", true, 4.0, 1.0, readImageEx, 0, 0 },
+	{ "writeImageEx", "rgb8", true, 4.0, 1.0, writeImageEx, 0, 0 },
+	{ "readImageRegionRGB", "rgb", true, 32.0, 1.0, readImageRegionRGB, 0, 0 },
+	{ "readImageRegionHCL", "hcl", true, 32.0, 1.0, readImageRegionHCL, 0, 0 },
+	{ "readImageRegionBytesRGB", "rgb8", true, 4.0, 1.0, readImageRegionBytesRGB, 0, 0 },
+	{ "readImageRegionBytesHCL", "hcl8", true, 4.0, 1.0, readImageRegionBytesHCL, 0, 0 },
+	{ "readImageRegionEx", "rgb8", true, 4.0, 1.0, readImageRegionEx, 0, 0 },
+	{ "readImageDecimatedRGB", "rgb", true, 2.0, 1.0, readImageDecimatedRGB, 0, 0 },
+	{ "readImageDecimatedHCL", "hcl", true, 2.0, 1.0, readImageDecimatedHCL, 0, 0 },
+	{ "readImageDecimatedBytesRGB", "rgb8", true, 0.25, 1.0, readImageDecimatedBytesRGB, 0, 0 },
+	{ "readImageDecimatedBytesHCL", "hcl8", true, 0.25, 1.0, readImageDecimatedBytesHCL, 0, 0 },
+	{ "decodeImageRGB", "rgb", true, 32.0, 1.0, decodeImageRGB, 0, 0 },
+	{ "decodeImageHCL", "hcl", true, 32.0, 1.0, decodeImageHCL, 0, 0 },
+	{ "decodeImageBytesRGB", "rgb8", true, 4.0, 1.0, decodeImageBytesRGB, 0, 0 },
+	{ "decodeImageBytesHCL", "hcl8", true, 4.0, 1.0, decodeImageBytesHCL, 0, 0 },
+	{ "decodeImageEx", "rgb8", true, 4.0, 1.0, decodeImageEx, 0, 0 },
+	{ "encodeImageRGB", "rgb", true, 32.0, 1.0, encodeImageRGB, 0, 0 },
+	{ "encodeImageHCL", "hcl", true, 32.0, 1.0, encodeImageHCL, 0, 0 },
+	{ "encodeImageBytesRGB", "rgb8", true, 4.0, 1.0, encodeImageBytesRGB, 0, 0 },
+	{ "encodeImageBytesHCL", "hcl8", true, 4.0, 1.0, encodeImageBytesHCL, 0, 0 },
+	{ "encodeImageEx", "rgb8", true, 4.0, 1.0, encodeImageEx, 0, 0 },
+	{ "readImageFd", "rgb8", true, 4.0, 1.0, readImageFd, 0, 0 },
+	{ "writeImageFd", "rgb8", true, 4.0, 1.0, writeImageFd, 0, 0 },
+	{ "readImageRows", "rgb8", true, 4.0, 1.0, readImageRows, 0, 0 },
+	{ "writeImageRows", "rgb8", true, 4.0, 1.0, writeImageRows, 0, 0 },
+	{ "compareImageFiles", "raw", true, 0.0, 2.0, compareImageFiles, setupCompare, 0 },
+	{ "buildImagePyramid", "rgb8", true, 0.0, 4.0/3.0, buildImagePyramid, 0, 0 },
+	
+	{ "readIndexedImage", "rgb8", false, 4.0, 0.0, readScratchImage,
+		setupIndexed, removeScratchFile },
+	{ "readIndexedImage/rows", "rgb8", false, 4.0, 0.0, readScratchImageRows,
+		setupIndexed, removeScratchFile },
+	{ "readIndexedImage/rle", "rgb8", false, 4.0, 0.0, readScratchImage,
+		setupRLE, removeScratchFile },
+	{ "readBitfieldImage", "rgb8", false, 5.0, 0.0, readScratchImage,
+		setupBitfields, removeScratchFile },
+	{ "writeIndexedImage", "u8", false, 2.0, 0.0, writeIndexedImage, 0, removeScratchFile },
+	{ "writeIndexedImage/rle", "u8", false, 2.0, 0.0, writeIndexedImageRLE,
+		0, removeScratchFile },
+	{ "writeImageEx/indexed", "rgb8", false, 4.0, 0.0, writeImageExIndexed,
+		nameIndexedFile, removeScratchFile },
+	
+	{ "applyLUT8", "rgb8", false, 6.0, 0.0, applyLUT8, 0, 0 },
+	{ "measureDifference", "f64", false, 16.0, 0.0, measureDifference, 0, 0 },
+	{ "measureDifferenceFloat", "f32", false, 8.0, 0.0, measureDifferenceFloat, 0, 0 },
+	{ "measureDifferenceBytes", "u8", false, 2.0, 0.0, measureDifferenceBytes, 0, 0 },
+	{ "resample", "f64", false, 10.0, 0.0, resample, 0, 0 },
+	{ "resampleFloat", "f32", false, 5.0, 0.0, resampleFloat, 0, 0 },
+	{ "resampleBytes", "u8", false, 1.25, 0.0, resampleBytes, 0, 0 },
+	{ "convolve", "f64", false, 16.0, 0.0, convolve, copySourcePlanes, 0 },
+	{ "convolveBytes", "u8", false, 2.0, 0.0, convolveBytes, copySourcePlanes, 0 },
+	{ "boxBlur", "f64", false, 16.0, 0.0, boxBlur, copySourcePlanes, 0 },
+	{ "boxBlurBytes", "u8", false, 2.0, 0.0, boxBlurBytes, copySourcePlanes, 0 },
+	{ "gaussianBlur", "f64", false, 16.0, 0.0, gaussianBlur, copySourcePlanes, 0 },
+	{ "gaussianBlurBytes", "u8", false, 2.0, 0.0, gaussianBlurBytes, copySourcePlanes, 0 },
+	{ "gaussianBlurBytes/context", "u8", false, 2.0, 0.0, gaussianBlurBytes,
+		setupContextBlur, unbindBenchContext },
+	{ "buildIntegralImage", "f64", false, 24.0, 0.0, buildIntegralImage, 0, 0 },
+	{ "buildIntegralImageBytes", "u8", false, 17.0, 0.0, buildIntegralImageBytes, 0, 0 },
+	{ "queryIntegralImage", "f64", false, 40.0, 0.0, queryIntegralImage,
+		buildIntegralTables, 0 },
+	{ "queryIntegralImageBytes", "u8", false, 40.0, 0.0, queryIntegralImageBytes,
+		buildIntegralTables, 0 }
+};
+
+const int CASE_COUNT = sizeof(CASES) / sizeof(CASES[0]);
+
+// Runs a case until it has taken at least MIN_SECONDS and MIN_ITERATIONS calls, after one
+// warm-up call, and prints the best call.
+int runCase(Bench &bench, const BenchCase &benchCase) {
+	if (benchCase.setup)
+		benchCase.setup(bench);
+	
+	bench.result = CGRESULT_OK;
+	double pixels = benchCase.run(bench);
+	int res = bench.result;
+	
+	double bestSeconds = HUGE_VAL, totalSeconds = 0.0;
+	unsigned long long bestCycles = 0;
+	int iterations = 0;
+	
+	while (res == CGRESULT_OK && iterations < MAX_ITERATIONS
+		&& (iterations < MIN_ITERATIONS || totalSeconds < MIN_SECONDS))
+	{
+		double startTime = currentTime();
+		unsigned long long startCycles = currentCycles();
+		benchCase.run(bench);
+		unsigned long long cycles = currentCycles() - startCycles;
+		double seconds = currentTime() - startTime;
+		
+		res = bench.result;
+		totalSeconds += seconds;
+		iterations++;
+		
+		if (seconds < bestSeconds) {
+			bestSeconds = seconds;
+			bestCycles = cycles;
+		}
+	}
+	
+	if (benchCase.teardown)
+		benchCase.teardown(bench);
+	
+	int bits = (benchCase.fileCase) ? bench.bits : 0;
+	
+	if (res != CGRESULT_OK) {
+		std::fprintf(
+			stderr, "bench: %s (%d bits, %d x %d) failed with result %d\n",
+			benchCase.name, bits, bench.width, bench.height, res);
+		return res;
+	}
+	
+	double bytes = pixels * (benchCase.bytesPerPixel + benchCase.filePasses*bits/8.0);
+	std::printf(
+		"%s,%s,%d,%d,%d,%d,%.9f,%.3f,%.3f,",
+		benchCase.name, benchCase.format, bits, bench.width, bench.height, iterations,
+		bestSeconds, 1e-6*pixels/bestSeconds, 1e-9*bytes/bestSeconds);
+	
+#ifdef CG_BENCH_TSC
+	std::printf("%.3f\n", (double)bestCycles/pixels);
+#else
+	std::printf("nan\n");
+#endif
+	
+	std::fflush(stdout);
+	return res;
+}
+
+} // end anonymous namespace
+
+int main(int argc, const char **argv) {
+	Bench bench;
+	std::vector<int> sizes;
+	int res, failures = 0;
+	
+	bench.dir = (argc > 1) ? argv[1] : ".";
+	
+	for (int k = 2; k < argc; k++) {
+		int size = std::atoi(argv[k]);
+		if (size < 8) {
+			std::fprintf(stderr, "bench: invalid image size '%s'\n", argv[k]);
+			return 1;
+		}
+		sizes.push_back(size);
+	}
+	
+	if (sizes.empty())
+		sizes.assign(DEFAULT_SIZES, DEFAULT_SIZES + sizeof(DEFAULT_SIZES)/sizeof(int));
+	
+	graphics_init(&res);
+	if (res != CGRESULT_OK) {
+		std::fprintf(stderr, "bench: graphics_init failed with result %d\n", res);
+		return 1;
+	}
+	
+	std::printf(
+		"name,format,bits,width,height,iterations,seconds,mpix_per_s,gb_per_s,"
+		"cycles_per_pixel\n");
+	
+	for (size_t s = 0; s < sizes.size(); s++) {
+		generateImage(bench, sizes[s], sizes[s]);
+		
+		bench.bits = 0;
+		for (int k = 0; k < CASE_COUNT; k++) {
+			if (!CASES[k].fileCase && runCase(bench, CASES[k]) != CGRESULT_OK)
+				failures++;
+		}
+		
+		for (int bits = 24; bits <= 32; bits += 8) {
+			res = prepareFiles(bench, bits);
+			
+			if (res != CGRESULT_OK) {
+				std::fprintf(
+					stderr, "bench: could not write %s (result %d)\n", bench.file.c_str(), res);
+				failures++;
+			}
+			else {
+				for (int k = 0; k < CASE_COUNT; k++) {
+					if (CASES[k].fileCase && runCase(bench, CASES[k]) != CGRESULT_OK)
+						failures++;
+				}
+			}
+			
+			removeFiles(bench);
+		}
+	}
+	
+	graphics_shutdown(&res);
+	return (failures == 0) ? 0 : 1;
+}
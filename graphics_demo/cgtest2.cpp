@@ -32,6 +32,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cmath>
 #include <iostream>
 #include <iomanip>
+#include <string>
 #include "graphdll.hpp"
 #include "imgdiff.hpp"
 
@@ -39,51 +40,13 @@ const double SQRT2 = std::sqrt(2.0);
 
 int main(int argc, const char **argv) {
 	int res = CGRESULT_UNSPECIFIED;
-	int w = 850;
-	int h = 850;
-	int size = w*h;
-	int w1, h1;
-	double *r1 = new double[size];
-	double *g1 = new double[size];
-	double *b1 = new double[size];
-	int w2, h2;
-	double *r2 = new double[size];
-	double *g2 = new double[size];
-	double *b2 = new double[size];
-	int w3, h3;
-	double *r3 = new double[size];
-	double *g3 = new double[size];
-	double *b3 = new double[size];
+	int precision = DIFF_PRECISION_DOUBLE;
 	
-	graphics_readImageRGB(argv[1], "bmp", &w, &h, &w1, &h1, r1, g1, b1, 0, &res);
-	if (res != CGRESULT_OK)
-		goto finish;
+	if (argc > 4 && std::string(argv[4]) == "float")
+		precision = DIFF_PRECISION_FLOAT;
 	
-	graphics_readImageRGB(argv[2], "bmp", &w, &h, &w2, &h2, r2, g2, b2, 0, &res);
-	if (res != CGRESULT_OK)
-		goto finish;
-	
-	if (w1 != w2 || h1 != h2) {
-		res = CGRESULT_UNSPECIFIED + CGRESULT_BAD_DIMENSION;
-		goto finish;
-	}
-	
-	res = imageDiff(size, r1, g1, b1, r2, g2, b2, r3, g3, b3);
-	if (res != CGRESULT_OK)
-		goto finish;
-	
-	graphics_writeImageRGB(argv[3], "bmp", &w1, &h1, r3, g3, b3, 0, &res);
-	
-finish:	
-	delete[] r1;
-	delete[] g1;
-	delete[] b1;
-	delete[] r2;
-	delete[] g2;
-	delete[] b2;
-	delete[] r3;
-	delete[] g3;
-	delete[] b3;
+	// NOTE: The source images are streamed, so their size is not limited by any buffers here.
+	res = imageDiffFiles(argv[1], argv[2], argv[3], precision);
 	
 	std::cout << "result=" << res << std::endl;
 	return res;
@@ -0,0 +1,162 @@
+
+/*
+Copyright (c) 2014, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "graphdll.hpp"
+
+// NOTE: Checks graphics_compareImageFiles on small images written to the directory given as the
+// first argument (or the current one): a copy that differs only in the padding of a row is
+// equal, a changed pixel marks its tile, and an indexed-color image is equal to the 24-bit
+// image of the same colors.
+
+const int WIDTH = 5;
+const int HEIGHT = 4;
+const int TILE = 2;
+const int TILES_X = (WIDTH + TILE - 1) / TILE;
+const int TILES_Y = (HEIGHT + TILE - 1) / TILE;
+
+const uchar PALETTE_R[4] = { 0, 255, 40, 200 };
+const uchar PALETTE_G[4] = { 0, 128, 90, 10 };
+const uchar PALETTE_B[4] = { 0, 64, 250, 30 };
+
+bool readFile(const std::string &fileName, std::vector<uchar> &data) {
+	FILE *file = std::fopen(fileName.c_str(), "rb");
+	if (!file)
+		return false;
+	
+	data.clear();
+	int c;
+	while ((c = std::fgetc(file)) != EOF)
+		data.push_back((uchar)c);
+	
+	std::fclose(file);
+	return true;
+}
+
+bool writeFile(const std::string &fileName, const std::vector<uchar> &data) {
+	FILE *file = std::fopen(fileName.c_str(), "wb");
+	if (!file)
+		return false;
+	
+	bool written = std::fwrite(&data[0], 1, data.size(), file) == data.size();
+	return std::fclose(file) == 0 && written;
+}
+
+// Compares two files and checks the equal flag and the number of changed tiles.
+int checkCompare(
+	const char *name, const std::string &file1, const std::string &file2,
+	int expectedEqual, int expectedChanged)
+{
+	uchar tileMap[TILES_X * TILES_Y];
+	int tileSize = TILE, maxTiles = TILES_X * TILES_Y;
+	int equal, tilesX, tilesY, res;
+	
+	graphics_compareImageFiles(
+		file1.c_str(), file2.c_str(), "bmp", &tileSize, &tileSize, &maxTiles,
+		&equal, &tilesX, &tilesY, tileMap, &res);
+	
+	int changed = 0;
+	for (int i = 0; i < TILES_X * TILES_Y; i++)
+		changed += tileMap[i];
+	
+	bool passed = res == CGRESULT_OK && equal == expectedEqual && changed == expectedChanged;
+	std::cout << name << ": result=" << res << " equal=" << equal << " changed=" << changed
+		<< ((passed) ? " ok" : " FAILED") << std::endl;
+	return (passed) ? 0 : 1;
+}
+
+int main(int argc, const char **argv) {
+	std::string dir = (argc > 1) ? argv[1] : ".";
+	std::string file = dir + "/cgtest3.bmp";
+	std::string padFile = dir + "/cgtest3_pad.bmp";
+	std::string pixelFile = dir + "/cgtest3_pixel.bmp";
+	std::string indexedFile = dir + "/cgtest3_indexed.bmp";
+	
+	int w = WIDTH, h = HEIGHT, res;
+	uchar indices[WIDTH * HEIGHT], r[WIDTH * HEIGHT], g[WIDTH * HEIGHT], b[WIDTH * HEIGHT];
+	
+	for (int i = 0; i < WIDTH * HEIGHT; i++) {
+		indices[i] = (uchar)((i % WIDTH + i / WIDTH) % 4);
+		r[i] = PALETTE_R[indices[i]];
+		g[i] = PALETTE_G[indices[i]];
+		b[i] = PALETTE_B[indices[i]];
+	}
+	
+	graphics_writeImageBytesRGB(file.c_str(), "bmp", &w, &h, r, g, b, 0, &res);
+	if (res != CGRESULT_OK) {
+		std::cout << "result=" << res << std::endl;
+		return res;
+	}
+	
+	int flags = 0, paletteSize = 4;
+	graphics_writeIndexedImage(
+		indexedFile.c_str(), "bmp", &w, &h, &w, &flags, indices, &paletteSize,
+		PALETTE_R, PALETTE_G, PALETTE_B, &res);
+	if (res != CGRESULT_OK) {
+		std::cout << "result=" << res << std::endl;
+		return res;
+	}
+	
+	// NOTE: The rows of a 5 pixel wide 24-bit bitmap have one pad byte each, after 15 bytes of
+	// pixels. The pixel change is in the top right tile.
+	std::vector<uchar> data;
+	if (!readFile(file, data)) {
+		std::cout << "result=" << CGRESULT_FOPEN_FAILED << std::endl;
+		return CGRESULT_FOPEN_FAILED;
+	}
+	
+	size_t bitmapOffset = data[10] | data[11] << 8 | data[12] << 16 | (size_t)data[13] << 24;
+	std::vector<uchar> padData(data), pixelData(data);
+	padData[bitmapOffset + 3*WIDTH] ^= 0xff;
+	pixelData[bitmapOffset + 16*(HEIGHT - 1) + 3*(WIDTH - 1)] ^= 0xff;
+	
+	if (!writeFile(padFile, padData) || !writeFile(pixelFile, pixelData)) {
+		std::cout << "result=" << CGRESULT_WRITE_ERROR << std::endl;
+		return CGRESULT_WRITE_ERROR;
+	}
+	
+	int failures = 0;
+	failures += checkCompare("padding", file, padFile, 1, 0);
+	failures += checkCompare("pixel", file, pixelFile, 0, 1);
+	failures += checkCompare("indexed", file, indexedFile, 1, 0);
+	failures += checkCompare("indexed pixel", indexedFile, pixelFile, 0, 1);
+	
+	std::remove(file.c_str());
+	std::remove(padFile.c_str());
+	std::remove(pixelFile.c_str());
+	std::remove(indexedFile.c_str());
+	
+	std::cout << "failures=" << failures << std::endl;
+	return failures;
+}
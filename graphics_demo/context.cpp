@@ -0,0 +1,134 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstring>
+#include "context.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace { // begin anonymous namespace
+
+// Data Definition
+cg_context defaultContext;
+thread_local cg_context *boundContext = 0;
+
+} // end anonymous namespace
+
+
+// Context Access
+cg_context &currentContext() {
+	return (boundContext) ? *boundContext : defaultContext;
+}
+
+cg_context *threadContext() {
+	return boundContext;
+}
+
+int contextThreads() {
+	int maxThreads = currentContext().maxThreads;
+#ifdef _OPENMP
+	return (maxThreads > 0) ? maxThreads : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+ScratchBuffer::ScratchBuffer(size_t size) : buffer(0), borrowed(0) {
+	cg_context *context = boundContext;
+	
+	if (context && !context->scratchInUse) {
+		if (context->scratchSize < size) {
+			char *scratch = new char[size];
+			if (!scratch)
+				return;
+			delete[] context->scratch;
+			context->scratch = scratch;
+			context->scratchSize = size;
+		}
+		
+		context->scratchInUse = true;
+		borrowed = context;
+		buffer = context->scratch;
+	}
+	else {
+		buffer = new char[size];
+	}
+}
+
+ScratchBuffer::~ScratchBuffer() {
+	if (borrowed)
+		borrowed->scratchInUse = false;
+	else
+		delete[] buffer;
+}
+
+
+// Public Interface
+void graphics_createContext(const int *max_threads, cg_context **out_context, int *out_result) {
+	if (*max_threads < 0) {
+		*out_result = CGRESULT_INVALID_ARGUMENT;
+		return;
+	}
+	
+	cg_context *context = new cg_context;
+	if (!context) {
+		*out_result = CGRESULT_ALLOC_FAILED;
+		return;
+	}
+	
+	std::memset(context, 0, sizeof(cg_context));
+	context->maxThreads = *max_threads;
+	
+	*out_context = context;
+	*out_result = CGRESULT_OK;
+}
+
+void graphics_bindContext(cg_context *context, int *out_result) {
+	boundContext = context;
+	*out_result = CGRESULT_OK;
+}
+
+void graphics_destroyContext(cg_context *context, int *out_result) {
+	if (!context) {
+		*out_result = CGRESULT_INVALID_ARGUMENT;
+		return;
+	}
+	
+	if (boundContext == context)
+		boundContext = 0;
+	
+	destroyDecodeCache(context->decodeCache);
+	delete[] context->scratch;
+	delete context;
+	*out_result = CGRESULT_OK;
+}
@@ -0,0 +1,90 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CG_CONTEXT_HPP
+#define CG_CONTEXT_HPP
+
+#include <cstddef>
+#include "graphdll.hpp"
+
+// NOTE: The library functions run in the context bound to the calling thread, or in the
+// default context if none is bound. The default context is shared by all such threads, so
+// its statistics are updated atomically and it owns no scratch buffer.
+
+// NOTE: Defined with the decode cache in graphdll.cpp. A context gets its cache the first time
+// graphics_configureDecodeCache is called in it, and destroyDecodeCache frees it.
+struct DecodeCache;
+
+struct StageStats {
+	long long count;
+	long long nanoseconds;
+	long long bytes;
+	long long pixels;
+};
+
+struct cg_context {
+	int maxThreads; // Zero means the OpenMP default.
+	char *scratch;
+	size_t scratchSize;
+	bool scratchInUse;
+	StageStats stats[CG_STAT_COUNT];
+	DecodeCache *decodeCache;
+};
+
+cg_context &currentContext();
+
+// Gets the context bound to the calling thread, or null if it runs in the default context.
+cg_context *threadContext();
+
+void destroyDecodeCache(DecodeCache *cache);
+
+// Gets the number of threads to use for a parallel region (a num_threads clause).
+int contextThreads();
+
+// NOTE: Borrows the scratch buffer of the current context for the lifetime of the object, or
+// allocates a temporary buffer if the context is the default one or its buffer is already
+// borrowed. data() is null if the allocation failed.
+class ScratchBuffer {
+public:
+	explicit ScratchBuffer(size_t size);
+	~ScratchBuffer();
+	
+	char *data() const { return buffer; }
+	
+private:
+	ScratchBuffer(const ScratchBuffer &);
+	ScratchBuffer &operator=(const ScratchBuffer &);
+	
+	char *buffer;
+	cg_context *borrowed;
+};
+
+#endif
@@ -0,0 +1,488 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <cstddef>
+#include "graphdll.hpp"
+#include "context.hpp"
+
+namespace { // begin anonymous namespace
+
+// Data Definition
+// NOTE: Vertical passes work on strips of this many columns, copied to a contiguous scratch
+// buffer. The strips are independent, so they can be filtered in parallel and in place, and
+// the inner loops run along the rows of a strip, where they can be vectorized.
+const int STRIP_COLUMNS = 128;
+
+// NOTE: The recursive Gaussian approximation overshoots for smaller sigmas (its impulse
+// response goes negative), so those are filtered with a sampled 3-tap kernel instead.
+const double MIN_RECURSIVE_SIGMA = 0.5;
+
+
+// Sample Types
+// NOTE: Byte channels are filtered in single precision and rounded back on each pass.
+template<typename T> struct FilterTraits {
+	typedef float Acc;
+	static T store(float v) { return (T)v; }
+};
+
+template<> struct FilterTraits<double> {
+	typedef double Acc;
+	static double store(double v) { return v; }
+};
+
+template<> struct FilterTraits<uchar> {
+	typedef float Acc;
+	static uchar store(float v) {
+		return (v <= 0.0f) ? 0 : (v >= 255.0f) ? 255 : (uchar)(v + 0.5f);
+	}
+};
+
+inline int clampIndex(int i, int size) {
+	return (i < 0) ? 0 : (i >= size) ? size - 1 : i;
+}
+
+
+// Pass Drivers
+// NOTE: A row operation gets a copy of one row, extended by pad samples on both sides by
+// repeating the edge samples, and a buffer for the filtered row. A strip operation gets a copy
+// of a strip of columns and a buffer for one filtered row of the strip; it is called once per
+// strip and writes the filtered rows back through the store callback of the driver.
+template<typename T, typename Op>
+void horizontalPass(int width, int height, T *pixels, const Op &op) {
+	typedef typename FilterTraits<T>::Acc Acc;
+	int pad = op.pad;
+	
+	#pragma omp parallel num_threads(contextThreads())
+	{
+		Acc *row = new Acc[(size_t)width + 2*pad];
+		Acc *out = new Acc[width];
+		
+		#pragma omp for schedule(static)
+		for (int y = 0; y < height; y++) {
+			T *p = pixels + (size_t)width * y;
+			
+			for (int i = 0; i < width + 2*pad; i++)
+				row[i] = (Acc)p[clampIndex(i - pad, width)];
+			
+			op.filter(width, row, out);
+			
+			for (int x = 0; x < width; x++)
+				p[x] = FilterTraits<T>::store(out[x]);
+		}
+		
+		delete[] row;
+		delete[] out;
+	}
+}
+
+template<typename T>
+struct StripStore {
+	StripStore(T *pixels, int width) : pixels(pixels), width(width) {}
+	
+	template<typename Acc>
+	void operator()(int y, int count, const Acc *row) const {
+		T *p = pixels + (size_t)width * y;
+		for (int x = 0; x < count; x++)
+			p[x] = FilterTraits<T>::store(row[x]);
+	}
+	
+	T *pixels;
+	int width;
+};
+
+template<typename T, typename Op>
+void verticalPass(int width, int height, T *pixels, const Op &op) {
+	typedef typename FilterTraits<T>::Acc Acc;
+	int strips = (width + STRIP_COLUMNS - 1) / STRIP_COLUMNS;
+	
+	#pragma omp parallel num_threads(contextThreads())
+	{
+		Acc *strip = new Acc[(size_t)height * STRIP_COLUMNS];
+		Acc *out = new Acc[(size_t)op.rowBuffers * STRIP_COLUMNS];
+		
+		#pragma omp for schedule(dynamic)
+		for (int s = 0; s < strips; s++) {
+			int x0 = s * STRIP_COLUMNS;
+			int count = (x0 + STRIP_COLUMNS < width) ? STRIP_COLUMNS : width - x0;
+			
+			for (int y = 0; y < height; y++) {
+				const T *p = pixels + (size_t)width * y + x0;
+				Acc *q = strip + (size_t)count * y;
+				for (int x = 0; x < count; x++)
+					q[x] = (Acc)p[x];
+			}
+			
+			op.filter(height, count, strip, out, StripStore<T>(pixels + x0, width));
+		}
+		
+		delete[] strip;
+		delete[] out;
+	}
+}
+
+
+// Convolution
+template<typename Acc>
+struct ConvolveRows {
+	ConvolveRows(const double *kernel, int radius) : pad(radius), kernel(kernel) {}
+	
+	void filter(int width, const Acc *row, Acc *out) const {
+		for (int x = 0; x < width; x++)
+			out[x] = 0;
+		
+		for (int k = 0; k <= 2*pad; k++) {
+			Acc wk = (Acc)kernel[k];
+			const Acc *r = row + k;
+			for (int x = 0; x < width; x++)
+				out[x] += wk * r[x];
+		}
+	}
+	
+	int pad;
+	const double *kernel;
+};
+
+template<typename Acc>
+struct ConvolveColumns {
+	ConvolveColumns(const double *kernel, int radius)
+		: rowBuffers(1), radius(radius), kernel(kernel) {}
+	
+	template<typename Store>
+	void filter(int height, int count, const Acc *strip, Acc *out, const Store &store) const {
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < count; x++)
+				out[x] = 0;
+			
+			for (int k = 0; k <= 2*radius; k++) {
+				Acc wk = (Acc)kernel[k];
+				const Acc *r = strip + (size_t)count * clampIndex(y + k - radius, height);
+				for (int x = 0; x < count; x++)
+					out[x] += wk * r[x];
+			}
+			
+			store(y, count, out);
+		}
+	}
+	
+	int rowBuffers;
+	int radius;
+	const double *kernel;
+};
+
+
+// Box Blur
+// NOTE: The box filters keep a running sum over the window, so their cost does not depend on
+// the radius.
+template<typename Acc>
+struct BoxRows {
+	BoxRows(int radius) : pad(radius) {}
+	
+	void filter(int width, const Acc *row, Acc *out) const {
+		int size = 2*pad + 1;
+		Acc scale = (Acc)1 / (Acc)size;
+		Acc sum = 0;
+		
+		for (int i = 0; i < size; i++)
+			sum += row[i];
+		
+		for (int x = 0; x < width; x++) {
+			out[x] = sum * scale;
+			if (x + 1 < width)
+				sum += row[x + size] - row[x];
+		}
+	}
+	
+	int pad;
+};
+
+template<typename Acc>
+struct BoxColumns {
+	BoxColumns(int radius) : rowBuffers(2), radius(radius) {}
+	
+	template<typename Store>
+	void filter(int height, int count, const Acc *strip, Acc *out, const Store &store) const {
+		Acc scale = (Acc)1 / (Acc)(2*radius + 1);
+		Acc *sum = out + STRIP_COLUMNS;
+		
+		for (int x = 0; x < count; x++)
+			sum[x] = 0;
+		
+		for (int k = -radius; k <= radius; k++) {
+			const Acc *r = strip + (size_t)count * clampIndex(k, height);
+			for (int x = 0; x < count; x++)
+				sum[x] += r[x];
+		}
+		
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < count; x++)
+				out[x] = sum[x] * scale;
+			
+			store(y, count, out);
+			
+			const Acc *add = strip + (size_t)count * clampIndex(y + radius + 1, height);
+			const Acc *sub = strip + (size_t)count * clampIndex(y - radius, height);
+			for (int x = 0; x < count; x++)
+				sum[x] += add[x] - sub[x];
+		}
+	}
+	
+	int rowBuffers;
+	int radius;
+};
+
+
+// Gaussian Blur
+// NOTE: This is the recursive approximation of Young and van Vliet, a third order causal
+// filter followed by the same filter run backwards. The cost does not depend on sigma. The
+// filter state at the edges starts from the edge samples, as if they were repeated.
+struct GaussCoefficients {
+	GaussCoefficients(double sigma);
+	
+	double b, a1, a2, a3;
+};
+
+GaussCoefficients::GaussCoefficients(double sigma) {
+	double q = (sigma >= 2.5)
+		? 0.98711*sigma - 0.96330
+		: 3.97156 - 4.14554*std::sqrt(1.0 - 0.26891*sigma);
+	double q2 = q*q, q3 = q2*q;
+	double b0 = 1.57825 + 2.44413*q + 1.4281*q2 + 0.422205*q3;
+	
+	a1 = (2.44413*q + 2.85619*q2 + 1.26661*q3) / b0;
+	a2 = -(1.4281*q2 + 1.26661*q3) / b0;
+	a3 = 0.422205*q3 / b0;
+	b = 1.0 - (a1 + a2 + a3);
+}
+
+// NOTE: The weights are the samples of the Gaussian at -1, 0 and 1, normalized to sum to 1. As
+// sigma goes to zero, the kernel goes to the identity.
+struct SmallGaussKernel {
+	SmallGaussKernel(double sigma);
+	
+	double weights[3];
+};
+
+SmallGaussKernel::SmallGaussKernel(double sigma) {
+	double side = std::exp(-0.5 / (sigma*sigma));
+	double total = 1.0 + 2.0*side;
+	weights[0] = weights[2] = side / total;
+	weights[1] = 1.0 / total;
+}
+
+template<typename Acc>
+struct GaussRows {
+	GaussRows(const GaussCoefficients &c) : pad(0), c(c) {}
+	
+	void filter(int width, const Acc *row, Acc *out) const {
+		Acc b = (Acc)c.b, a1 = (Acc)c.a1, a2 = (Acc)c.a2, a3 = (Acc)c.a3;
+		Acc w1 = row[0], w2 = row[0], w3 = row[0];
+		
+		for (int x = 0; x < width; x++) {
+			Acc w = b*row[x] + a1*w1 + a2*w2 + a3*w3;
+			out[x] = w;
+			w3 = w2; w2 = w1; w1 = w;
+		}
+		
+		w1 = w2 = w3 = out[width-1];
+		for (int x = width - 1; x >= 0; x--) {
+			Acc w = b*out[x] + a1*w1 + a2*w2 + a3*w3;
+			out[x] = w;
+			w3 = w2; w2 = w1; w1 = w;
+		}
+	}
+	
+	int pad;
+	GaussCoefficients c;
+};
+
+// NOTE: The vertical filter runs the recursion on whole strip rows at a time. The causal pass
+// overwrites the strip, and the anticausal pass stores each row as soon as it is done.
+template<typename Acc>
+struct GaussColumns {
+	GaussColumns(const GaussCoefficients &c) : rowBuffers(3), c(c) {}
+	
+	template<typename Store>
+	void filter(int height, int count, Acc *strip, Acc *out, const Store &store) const {
+		Acc b = (Acc)c.b, a1 = (Acc)c.a1, a2 = (Acc)c.a2, a3 = (Acc)c.a3;
+		Acc *r1 = out, *r2 = out + STRIP_COLUMNS, *r3 = out + 2*STRIP_COLUMNS;
+		
+		for (int y = 0; y < height; y++) {
+			Acc *r = strip + (size_t)count * y;
+			const Acc *p1 = strip + (size_t)count * ((y > 0) ? y - 1 : 0);
+			const Acc *p2 = strip + (size_t)count * ((y > 1) ? y - 2 : 0);
+			const Acc *p3 = strip + (size_t)count * ((y > 2) ? y - 3 : 0);
+			if (y == 0) { p1 = p2 = p3 = r; }
+			
+			for (int x = 0; x < count; x++)
+				r[x] = b*r[x] + a1*p1[x] + a2*p2[x] + a3*p3[x];
+		}
+		
+		const Acc *last = strip + (size_t)count * (height - 1);
+		for (int x = 0; x < count; x++)
+			r1[x] = r2[x] = r3[x] = last[x];
+		
+		for (int y = height - 1; y >= 0; y--) {
+			const Acc *r = strip + (size_t)count * y;
+			for (int x = 0; x < count; x++)
+				r3[x] = b*r[x] + a1*r1[x] + a2*r2[x] + a3*r3[x];
+			
+			store(y, count, r3);
+			
+			Acc *t = r3; r3 = r2; r2 = r1; r1 = t;
+		}
+	}
+	
+	int rowBuffers;
+	GaussCoefficients c;
+};
+
+
+// Filter Entry Points
+template<typename T>
+int convolve(
+	const int *width, const int *height, T *pixels,
+	const double *kernel_x, const int *radius_x,
+	const double *kernel_y, const int *radius_y)
+{
+	typedef typename FilterTraits<T>::Acc Acc;
+	
+	if (*width <= 0 || *height <= 0)
+		return CGRESULT_BAD_DIMENSION;
+	else if ((kernel_x && *radius_x < 0) || (kernel_y && *radius_y < 0))
+		return CGRESULT_INVALID_ARGUMENT;
+	
+	if (kernel_x)
+		horizontalPass(*width, *height, pixels, ConvolveRows<Acc>(kernel_x, *radius_x));
+	if (kernel_y)
+		verticalPass(*width, *height, pixels, ConvolveColumns<Acc>(kernel_y, *radius_y));
+	
+	return CGRESULT_OK;
+}
+
+template<typename T>
+int boxBlur(
+	const int *width, const int *height, T *pixels, const int *radius_x, const int *radius_y)
+{
+	typedef typename FilterTraits<T>::Acc Acc;
+	
+	if (*width <= 0 || *height <= 0)
+		return CGRESULT_BAD_DIMENSION;
+	else if (*radius_x < 0 || *radius_y < 0)
+		return CGRESULT_INVALID_ARGUMENT;
+	
+	if (*radius_x > 0)
+		horizontalPass(*width, *height, pixels, BoxRows<Acc>(*radius_x));
+	if (*radius_y > 0)
+		verticalPass(*width, *height, pixels, BoxColumns<Acc>(*radius_y));
+	
+	return CGRESULT_OK;
+}
+
+template<typename T>
+int gaussianBlur(
+	const int *width, const int *height, T *pixels, const double *sigma_x, const double *sigma_y)
+{
+	typedef typename FilterTraits<T>::Acc Acc;
+	
+	if (*width <= 0 || *height <= 0)
+		return CGRESULT_BAD_DIMENSION;
+	else if (!(*sigma_x >= 0.0) || !(*sigma_y >= 0.0))
+		return CGRESULT_INVALID_ARGUMENT;
+	
+	SmallGaussKernel smallX(*sigma_x), smallY(*sigma_y);
+	
+	if (*sigma_x >= MIN_RECURSIVE_SIGMA)
+		horizontalPass(*width, *height, pixels, GaussRows<Acc>(GaussCoefficients(*sigma_x)));
+	else if (*sigma_x > 0.0)
+		horizontalPass(*width, *height, pixels, ConvolveRows<Acc>(smallX.weights, 1));
+	
+	if (*sigma_y >= MIN_RECURSIVE_SIGMA)
+		verticalPass(*width, *height, pixels, GaussColumns<Acc>(GaussCoefficients(*sigma_y)));
+	else if (*sigma_y > 0.0)
+		verticalPass(*width, *height, pixels, ConvolveColumns<Acc>(smallY.weights, 1));
+	
+	return CGRESULT_OK;
+}
+
+} // end anonymous namespace
+
+
+// Public Interface
+void graphics_convolve(
+	const int *width, const int *height, double *pixels,
+	const double *kernel_x, const int *radius_x,
+	const double *kernel_y, const int *radius_y,
+	int *out_result)
+{
+	*out_result = convolve(width, height, pixels, kernel_x, radius_x, kernel_y, radius_y);
+}
+
+void graphics_convolveBytes(
+	const int *width, const int *height, uchar *pixels,
+	const double *kernel_x, const int *radius_x,
+	const double *kernel_y, const int *radius_y,
+	int *out_result)
+{
+	*out_result = convolve(width, height, pixels, kernel_x, radius_x, kernel_y, radius_y);
+}
+
+void graphics_boxBlur(
+	const int *width, const int *height, double *pixels,
+	const int *radius_x, const int *radius_y,
+	int *out_result)
+{
+	*out_result = boxBlur(width, height, pixels, radius_x, radius_y);
+}
+
+void graphics_boxBlurBytes(
+	const int *width, const int *height, uchar *pixels,
+	const int *radius_x, const int *radius_y,
+	int *out_result)
+{
+	*out_result = boxBlur(width, height, pixels, radius_x, radius_y);
+}
+
+void graphics_gaussianBlur(
+	const int *width, const int *height, double *pixels,
+	const double *sigma_x, const double *sigma_y,
+	int *out_result)
+{
+	*out_result = gaussianBlur(width, height, pixels, sigma_x, sigma_y);
+}
+
+void graphics_gaussianBlurBytes(
+	const int *width, const int *height, uchar *pixels,
+	const double *sigma_x, const double *sigma_y,
+	int *out_result)
+{
+	*out_result = gaussianBlur(width, height, pixels, sigma_x, sigma_y);
+}
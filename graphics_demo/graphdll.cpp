@@ -29,16 +29,72 @@ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
 EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <cerrno>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <list>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
+#include <sys/stat.h>
 #include "graphdll.hpp"
+#include "context.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef WIN32
+#include <io.h>
+#define CG_FD_READ  _read
+#define CG_FD_WRITE _write
+#define CG_FD_SEEK  _lseeki64
+#define CG_FSEEK    _fseeki64
+#define CG_FTELL    _ftelli64
+#else
+#include <unistd.h>
+#define CG_FD_READ  ::read
+#define CG_FD_WRITE ::write
+#define CG_FD_SEEK  ::lseek
+#define CG_FSEEK    fseeko
+#define CG_FTELL    ftello
+#endif
+
+#ifdef CG_GRAPHDLL_STATS
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CG_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace { // begin anonymous namespace
 
 // Data Definition
 const int PIXEL_BUFFER_SIZE = 4 * 1024;
+
+// NOTE: The file size field of a BMP file is 32 bits wide. Bitmaps that are read are only
+// limited by what 64-bit sizes and offsets can address.
+const unsigned long long MAX_BMP_FILE_SIZE = 0xffffffffULL;
+const unsigned long long MAX_BITMAP_SIZE = 0x3fffffffffffffffULL;
+
+// NOTE: These are the values of BI_RGB, BI_RLE8 and BI_RLE4, whose names clash with the
+// macros of the Windows headers.
+const unsigned int BMP_COMPRESSION_NONE = 0;
+const unsigned int BMP_COMPRESSION_RLE8 = 1;
+const unsigned int BMP_COMPRESSION_RLE4 = 2;
+const unsigned int BMP_COMPRESSION_BITFIELDS = 3;
+
 const double RECIPROCAL_255 = 1.0 / 255.0;
 
 const double LUMA_COEFF_R_REC709 = 0.2126;
@@ -157,6 +213,164 @@ int getImageFormat(const std::string &path, const std::string &type) {
 	return imageFormat;
 }
 
+// NOTE: Memory buffers have no file name, so their format is recognized by its signature.
+int getBufferImageFormat(const char *data, size_t size) {
+	if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+		return CG_FILE_FORMAT_BMP;
+	else
+		return CG_FILE_FORMAT_NONE;
+}
+
+size_t channelSize(int dataFormat) {
+	switch (dataFormat) {
+	case CG_DATA_FORMAT_RGB:
+	case CG_DATA_FORMAT_HCL:
+		return sizeof(double);
+	case CG_DATA_FORMAT_RGB_BYTES:
+	case CG_DATA_FORMAT_HCL_BYTES:
+		return sizeof(uchar);
+	default:
+		return 0;
+	}
+}
+
+// NOTE: The rows of a bitmap array are padded to a multiple of 4 bytes. Bitmap sizes and
+// offsets are computed in 64 bits, so that they cannot overflow for any header dimensions.
+unsigned long long bitmapRowBytes(unsigned int bitsPerPixel, int width) {
+	return ((unsigned long long)bitsPerPixel * width + 31) / 32 * 4;
+}
+
+// NOTE: A row stride of zero means that the rows are tightly packed. Otherwise the stride must
+// be at least the row width. The rows of an image are visited in the order they are stored in
+// the file. If that is the reverse of the order of the rows in the channel buffers, the visit
+// starts at the last row of the buffers and steps backwards. The layout gives the byte offset
+// of the first visited row, and the number of bytes from the end of one visited row to the
+// start of the next.
+struct RowLayout {
+	ptrdiff_t first;
+	ptrdiff_t skip;
+};
+
+int rowLayout(
+	int dataFormat, int width, int height, int rowStride, bool reversed,
+	RowLayout &layout, int &result)
+{
+	if (rowStride == 0)
+		rowStride = width;
+	else if (rowStride < width)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	ptrdiff_t size = (ptrdiff_t)channelSize(dataFormat);
+	ptrdiff_t strideBytes = size * rowStride;
+	
+	if (reversed) {
+		layout.first = strideBytes * (height - 1);
+		layout.skip = -strideBytes - size * width;
+	}
+	else {
+		layout.first = 0;
+		layout.skip = strideBytes - size * width;
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+void advanceChannels(ptrdiff_t bytes, void *&r, void *&g, void *&b, void *&a) {
+	if (r) { r = (char *)r + bytes; }
+	if (g) { g = (char *)g + bytes; }
+	if (b) { b = (char *)b + bytes; }
+	if (a) { a = (char *)a + bytes; }
+}
+
+void advanceChannels(ptrdiff_t bytes, const void *&r, const void *&g, const void *&b, const void *&a) {
+	if (r) { r = (const char *)r + bytes; }
+	if (g) { g = (const char *)g + bytes; }
+	if (b) { b = (const char *)b + bytes; }
+	if (a) { a = (const char *)a + bytes; }
+}
+
+template<typename T>
+T *rowStart(T *p, size_t offset) {
+	return (p) ? p + offset : 0;
+}
+
+
+// Instrumentation
+// NOTE: A span measures one stage from its construction to stop() (or its destruction), and
+// adds its byte and pixel counts to the totals of the stage in the current context. Spans
+// are opened per chunk or row of work, never per pixel, and the totals are updated
+// atomically, so they can be left on in production builds. Without CG_GRAPHDLL_STATS, spans
+// compile to nothing.
+#ifdef CG_GRAPHDLL_STATS
+long long monotonicNanoseconds() {
+#ifdef WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (long long)((double)count.QuadPart * (1e9 / (double)frequency.QuadPart));
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+class StatSpan {
+public:
+	explicit StatSpan(int stage)
+		: stats(currentContext().stats), stage(stage), bytes(0), pixels(0),
+		  start(monotonicNanoseconds()) {}
+	
+	~StatSpan() { stop(); }
+	
+	void count(long long addedBytes, long long addedPixels) {
+		bytes += addedBytes;
+		pixels += addedPixels;
+	}
+	
+	void stop() {
+		if (stage < 0)
+			return;
+		
+		StageStats &total = stats[stage];
+		long long elapsed = monotonicNanoseconds() - start;
+		#pragma omp atomic
+		total.count += 1;
+		#pragma omp atomic
+		total.nanoseconds += elapsed;
+		#pragma omp atomic
+		total.bytes += bytes;
+		#pragma omp atomic
+		total.pixels += pixels;
+		stage = -1;
+	}
+	
+private:
+	StageStats *stats;
+	int stage;
+	long long bytes;
+	long long pixels;
+	long long start;
+};
+#else
+class StatSpan {
+public:
+	explicit StatSpan(int stage) {}
+	void count(long long addedBytes, long long addedPixels) {}
+	void stop() {}
+};
+#endif
+
+FILE *openFile(const char *path, const char *mode) {
+	StatSpan span(CG_STAT_OPEN_CLOSE);
+	return std::fopen(path, mode);
+}
+
+int closeFile(FILE *fptr) {
+	StatSpan span(CG_STAT_OPEN_CLOSE);
+	return std::fclose(fptr);
+}
+
 
 // Channel Extraction
 typedef void (*Extractor)(unsigned int pixel, void *&channel);
@@ -392,52 +606,646 @@ unsigned int packBytesHCLAinRGBA(const void *&h, const void *&c, const void *&l,
 }
 
 
+// Channel Conversion
+struct DoubleChannels {
+	typedef double Value;
+	static double load(double v)     { return v; }
+	static double loadHue(double v)  { return v; }
+	static double store(double d)    { return d; }
+	static double storeHue(double d) { return d; }
+};
+
+struct ByteChannels {
+	typedef uchar Value;
+	static double load(uchar v)     { return doubleFrom8bit(v); }
+	static double loadHue(uchar v)  { return 6.0 * doubleFrom8bit(v); }
+	static uchar store(double d)    { return (uchar)doubleTo8bit(d); }
+	static uchar storeHue(double d) { return (uchar)doubleTo8bit(d / 6.0); }
+};
+
+// NOTE: The kernels are specialized for each subset of requested output channels. Without hue,
+// there are no branches on the sextant, and the luma-only kernel is a plain weighted sum that
+// the compiler vectorizes. All subsets produce exactly the values of the full conversion.
+template<typename Channels, bool WithHue, bool WithChroma, bool WithLuma>
+void convertPixelsRGBtoHCL(
+	size_t count,
+	const typename Channels::Value *r, const typename Channels::Value *g,
+	const typename Channels::Value *b,
+	typename Channels::Value *h, typename Channels::Value *c, typename Channels::Value *l)
+{
+	for (size_t i = 0; i < count; i++) {
+		double rd = Channels::load(r[i]);
+		double gd = Channels::load(g[i]);
+		double bd = Channels::load(b[i]);
+		
+		if (WithHue) {
+			double hd, cd, ld;
+			convertRGBtoHCL(rd, gd, bd, hd, cd, ld);
+			h[i] = Channels::storeHue(hd);
+			if (WithChroma) { c[i] = Channels::store(cd); }
+			if (WithLuma)   { l[i] = Channels::store(ld); }
+			continue;
+		}
+		
+		if (WithChroma) {
+			double m1 = (rd > gd) ? rd : gd;
+			double m0 = (rd > gd) ? gd : rd;
+			m1 = (bd > m1) ? bd : m1;
+			m0 = (bd < m0) ? bd : m0;
+			c[i] = Channels::store(m1 - m0);
+		}
+		
+		if (WithLuma)
+			l[i] = Channels::store(LUMA_COEFF_R*rd + LUMA_COEFF_G*gd + LUMA_COEFF_B*bd);
+	}
+}
+
+template<typename Channels, bool WithRed, bool WithGreen, bool WithBlue>
+void convertPixelsHCLtoRGB(
+	size_t count,
+	const typename Channels::Value *h, const typename Channels::Value *c,
+	const typename Channels::Value *l,
+	typename Channels::Value *r, typename Channels::Value *g, typename Channels::Value *b)
+{
+	for (size_t i = 0; i < count; i++) {
+		double rd, gd, bd;
+		convertHCLtoRGB(
+			Channels::loadHue(h[i]), Channels::load(c[i]), Channels::load(l[i]), rd, gd, bd);
+		if (WithRed)   { r[i] = Channels::store(rd); }
+		if (WithGreen) { g[i] = Channels::store(gd); }
+		if (WithBlue)  { b[i] = Channels::store(bd); }
+	}
+}
+
+// NOTE: Null output buffers are skipped, like in readBMP.
+template<typename Channels>
+void convertChannelsRGBtoHCL(
+	size_t count,
+	const typename Channels::Value *r, const typename Channels::Value *g,
+	const typename Channels::Value *b,
+	typename Channels::Value *h, typename Channels::Value *c, typename Channels::Value *l)
+{
+	switch ((h ? 4 : 0) | (c ? 2 : 0) | (l ? 1 : 0)) {
+	case 1: convertPixelsRGBtoHCL<Channels, false, false, true >(count, r, g, b, h, c, l); break;
+	case 2: convertPixelsRGBtoHCL<Channels, false, true,  false>(count, r, g, b, h, c, l); break;
+	case 3: convertPixelsRGBtoHCL<Channels, false, true,  true >(count, r, g, b, h, c, l); break;
+	case 4: convertPixelsRGBtoHCL<Channels, true,  false, false>(count, r, g, b, h, c, l); break;
+	case 5: convertPixelsRGBtoHCL<Channels, true,  false, true >(count, r, g, b, h, c, l); break;
+	case 6: convertPixelsRGBtoHCL<Channels, true,  true,  false>(count, r, g, b, h, c, l); break;
+	case 7: convertPixelsRGBtoHCL<Channels, true,  true,  true >(count, r, g, b, h, c, l); break;
+	default: break; // Nothing requested.
+	}
+}
+
+template<typename Channels>
+void convertChannelsHCLtoRGB(
+	size_t count,
+	const typename Channels::Value *h, const typename Channels::Value *c,
+	const typename Channels::Value *l,
+	typename Channels::Value *r, typename Channels::Value *g, typename Channels::Value *b)
+{
+	switch ((r ? 4 : 0) | (g ? 2 : 0) | (b ? 1 : 0)) {
+	case 1: convertPixelsHCLtoRGB<Channels, false, false, true >(count, h, c, l, r, g, b); break;
+	case 2: convertPixelsHCLtoRGB<Channels, false, true,  false>(count, h, c, l, r, g, b); break;
+	case 3: convertPixelsHCLtoRGB<Channels, false, true,  true >(count, h, c, l, r, g, b); break;
+	case 4: convertPixelsHCLtoRGB<Channels, true,  false, false>(count, h, c, l, r, g, b); break;
+	case 5: convertPixelsHCLtoRGB<Channels, true,  false, true >(count, h, c, l, r, g, b); break;
+	case 6: convertPixelsHCLtoRGB<Channels, true,  true,  false>(count, h, c, l, r, g, b); break;
+	case 7: convertPixelsHCLtoRGB<Channels, true,  true,  true >(count, h, c, l, r, g, b); break;
+	default: break; // Nothing requested.
+	}
+}
+
+// NOTE: Tightly packed buffers are converted in one run, other layouts one row at a time.
+template<typename Channels>
+int convertImageRGBtoHCL(
+	int width, int height, int inStride,
+	const typename Channels::Value *r, const typename Channels::Value *g,
+	const typename Channels::Value *b,
+	int outStride,
+	typename Channels::Value *h, typename Channels::Value *c, typename Channels::Value *l,
+	int &result)
+{
+	if (inStride == 0)  { inStride = width; }
+	if (outStride == 0) { outStride = width; }
+	if (width < 0 || height < 0 || inStride < width || outStride < width)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	StatSpan span(CG_STAT_CONVERT);
+	span.count(0, (long long)width * height);
+	
+	if (inStride == width && outStride == width) {
+		convertChannelsRGBtoHCL<Channels>((size_t)width * (size_t)height, r, g, b, h, c, l);
+		return result = CGRESULT_OK;
+	}
+	
+	for (int y = 0; y < height; y++) {
+		size_t in = (size_t)inStride * y, out = (size_t)outStride * y;
+		convertChannelsRGBtoHCL<Channels>(
+			width, r + in, g + in, b + in, rowStart(h, out), rowStart(c, out), rowStart(l, out));
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+template<typename Channels>
+int convertImageHCLtoRGB(
+	int width, int height, int inStride,
+	const typename Channels::Value *h, const typename Channels::Value *c,
+	const typename Channels::Value *l,
+	int outStride,
+	typename Channels::Value *r, typename Channels::Value *g, typename Channels::Value *b,
+	int &result)
+{
+	if (inStride == 0)  { inStride = width; }
+	if (outStride == 0) { outStride = width; }
+	if (width < 0 || height < 0 || inStride < width || outStride < width)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	StatSpan span(CG_STAT_CONVERT);
+	span.count(0, (long long)width * height);
+	
+	if (inStride == width && outStride == width) {
+		convertChannelsHCLtoRGB<Channels>((size_t)width * (size_t)height, h, c, l, r, g, b);
+		return result = CGRESULT_OK;
+	}
+	
+	for (int y = 0; y < height; y++) {
+		size_t in = (size_t)inStride * y, out = (size_t)outStride * y;
+		convertChannelsHCLtoRGB<Channels>(
+			width, h + in, c + in, l + in, rowStart(r, out), rowStart(g, out), rowStart(b, out));
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+
+// Table Lookup
+// NOTE: The kernels make a single pass over the pixels, and look up every channel of each pixel
+// (or each vector of pixels) before moving on, so that each pixel is loaded and stored once.
+struct LUTChannel {
+	const uchar *lut;
+	const uchar *in;
+	uchar *out;
+};
+
+typedef void (*LUTKernel)(const LUTChannel *channels, int channelCount, size_t begin, size_t end);
+
+void applyLUT8Scalar(const LUTChannel *channels, int channelCount, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		for (int c = 0; c < channelCount; c++)
+			channels[c].out[i] = channels[c].lut[channels[c].in[i]];
+	}
+}
+
+#ifdef CG_X86_SIMD
+// NOTE: The 256-entry table is split into 16 rows of 16 entries, each held in a register.
+// VPSHUFB looks up the low nibble of every byte in each row, and the high nibble selects the
+// row: XOR-ing it with the row number and adding 0x70 with saturation sets bit 7 (which makes
+// VPSHUFB yield zero) in every lane that belongs to another row.
+__attribute__ ((target ("avx2")))
+void applyLUT8AVX2(const LUTChannel *channels, int channelCount, size_t begin, size_t end) {
+	__m256i rows[4][16];
+	for (int c = 0; c < channelCount; c++) {
+		for (int k = 0; k < 16; k++) {
+			rows[c][k] = _mm256_broadcastsi128_si256(
+				_mm_loadu_si128((const __m128i*)(channels[c].lut + 16*k)));
+		}
+	}
+	
+	const __m256i bias = _mm256_set1_epi8(0x70);
+	size_t i = begin;
+	
+	for (; i + 32 <= end; i += 32) {
+		for (int c = 0; c < channelCount; c++) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)(channels[c].in + i));
+			__m256i acc = _mm256_setzero_si256();
+			
+			for (int k = 0; k < 16; k++) {
+				__m256i row = _mm256_set1_epi8((char)(k << 4));
+				__m256i idx = _mm256_adds_epu8(_mm256_xor_si256(v, row), bias);
+				acc = _mm256_or_si256(acc, _mm256_shuffle_epi8(rows[c][k], idx));
+			}
+			
+			_mm256_storeu_si256((__m256i*)(channels[c].out + i), acc);
+		}
+	}
+	
+	applyLUT8Scalar(channels, channelCount, i, end);
+}
+
+// NOTE: VPERMI2B looks up the low 7 bits of every byte in a 128-entry table held in two
+// registers, so two lookups and a blend on bit 7 cover the whole 256-entry table.
+__attribute__ ((target ("avx512f,avx512bw,avx512vbmi")))
+void applyLUT8AVX512(const LUTChannel *channels, int channelCount, size_t begin, size_t end) {
+	__m512i tables[4][4];
+	for (int c = 0; c < channelCount; c++) {
+		for (int k = 0; k < 4; k++)
+			tables[c][k] = _mm512_loadu_si512(channels[c].lut + 64*k);
+	}
+	
+	size_t i = begin;
+	
+	for (; i + 64 <= end; i += 64) {
+		for (int c = 0; c < channelCount; c++) {
+			const __m512i *t = tables[c];
+			__m512i v = _mm512_loadu_si512(channels[c].in + i);
+			__m512i lo = _mm512_permutex2var_epi8(t[0], v, t[1]);
+			__m512i hi = _mm512_permutex2var_epi8(t[2], v, t[3]);
+			__m512i mapped = _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), lo, hi);
+			_mm512_storeu_si512(channels[c].out + i, mapped);
+		}
+	}
+	
+	applyLUT8Scalar(channels, channelCount, i, end);
+}
+#endif
+
+LUTKernel selectLUTKernel() {
+#ifdef CG_X86_SIMD
+	if (__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw"))
+		return applyLUT8AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return applyLUT8AVX2;
+#endif
+	return applyLUT8Scalar;
+}
+
+
+// Bit Field Unpacking
+// NOTE: The pixels of bit field bitmaps are unpacked a row at a time into the layout of 32-bit
+// pixels (blue, green, red and alpha bytes), which the extractors read. Each channel is shifted
+// down and expanded to 8 bits by replicating its high bits, so that its full range maps to
+// 0-255. Channels without a mask are zero, except alpha, which is opaque. The masks are given
+// in the order red, green, blue and alpha. The common mask sets have kernels of their own, and
+// the others look up each channel in a table.
+struct BitfieldUnpacker;
+
+typedef void (*UnpackKernel)(const BitfieldUnpacker &unpacker, const uchar *in, uchar *out, int count);
+
+struct BitfieldUnpacker {
+	UnpackKernel kernel;
+	unsigned int bytesPerPixel;
+	unsigned int masks[4];
+	unsigned int shifts[4];
+	uchar values[4][256];
+};
+
+uchar expandBits(unsigned int value, unsigned int bits) {
+	unsigned int expanded = 0;
+	for (int position = 8 - (int)bits; position > -(int)bits; position -= bits)
+		expanded |= (position >= 0) ? value << position : value >> -position;
+	return (uchar)expanded;
+}
+
+void unpackMasked(const BitfieldUnpacker &unpacker, const uchar *in, uchar *out, int count) {
+	const unsigned int *masks = unpacker.masks;
+	const unsigned int *shifts = unpacker.shifts;
+	for (int i = 0; i < count; i++, in += unpacker.bytesPerPixel, out += 4) {
+		unsigned int pixel = 0;
+		std::memcpy(&pixel, in, unpacker.bytesPerPixel);
+		out[0] = unpacker.values[2][(pixel & masks[2]) >> shifts[2]];
+		out[1] = unpacker.values[1][(pixel & masks[1]) >> shifts[1]];
+		out[2] = unpacker.values[0][(pixel & masks[0]) >> shifts[0]];
+		out[3] = unpacker.values[3][(pixel & masks[3]) >> shifts[3]];
+	}
+}
+
+// NOTE: RGB565 has a red shift of 11 and 6 green bits, RGB555 a red shift of 10 and 5 green bits.
+template<int RedShift, int GreenBits>
+void unpack16Scalar(const BitfieldUnpacker &, const uchar *in, uchar *out, int count) {
+	for (int i = 0; i < count; i++, in += 2, out += 4) {
+		unsigned int pixel = in[0] | in[1] << 8;
+		unsigned int r = 0x1fU & pixel >> RedShift;
+		unsigned int g = ((1U << GreenBits) - 1) & pixel >> 5;
+		unsigned int b = 0x1fU & pixel;
+		out[0] = (uchar)(b << 3 | b >> 2);
+		out[1] = (uchar)(g << (8 - GreenBits) | g >> (2*GreenBits - 8));
+		out[2] = (uchar)(r << 3 | r >> 2);
+		out[3] = 0xff;
+	}
+}
+
+void unpackBGRX(const BitfieldUnpacker &, const uchar *in, uchar *out, int count) {
+	for (int i = 0; i < count; i++) {
+		unsigned int pixel;
+		std::memcpy(&pixel, in + 4*i, 4);
+		pixel |= 0xff000000U;
+		std::memcpy(out + 4*i, &pixel, 4);
+	}
+}
+
+#ifdef CG_X86_SIMD
+// NOTE: Each iteration expands 16 pixels in 16-bit lanes, pairs blue with green and red with
+// opaque alpha, and interleaves the pairs into pixels. The interleave works within 128-bit
+// lanes, so the two halves are put back in order before they are stored.
+template<int RedShift, int GreenBits>
+__attribute__ ((target ("avx2")))
+void unpack16AVX2(const BitfieldUnpacker &unpacker, const uchar *in, uchar *out, int count) {
+	const __m256i mask5 = _mm256_set1_epi16(0x1f);
+	const __m256i maskG = _mm256_set1_epi16((1 << GreenBits) - 1);
+	const __m256i alpha = _mm256_set1_epi16((short)0xff00);
+	int i = 0;
+	
+	for (; i + 16 <= count; i += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(in + 2*i));
+		__m256i r = _mm256_and_si256(_mm256_srli_epi16(v, RedShift), mask5);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi16(v, 5), maskG);
+		__m256i b = _mm256_and_si256(v, mask5);
+		r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+		g = _mm256_or_si256(
+			_mm256_slli_epi16(g, 8 - GreenBits), _mm256_srli_epi16(g, 2*GreenBits - 8));
+		b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+		
+		__m256i bg = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+		__m256i ra = _mm256_or_si256(r, alpha);
+		__m256i lo = _mm256_unpacklo_epi16(bg, ra);
+		__m256i hi = _mm256_unpackhi_epi16(bg, ra);
+		_mm256_storeu_si256((__m256i*)(out + 4*i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(out + 4*i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	
+	unpack16Scalar<RedShift, GreenBits>(unpacker, in + 2*i, out + 4*i, count - i);
+}
+#endif
+
+void initBitfieldUnpacker(
+	const unsigned int *masks, unsigned int bytesPerPixel, BitfieldUnpacker &unpacker)
+{
+	unpacker.bytesPerPixel = bytesPerPixel;
+	
+	// NOTE: Only the 8 high bits of wider channels are used.
+	for (int c = 0; c < 4; c++) {
+		unsigned int shift = 0, bits = 0;
+		if (masks[c]) {
+			while (!(masks[c] >> shift & 1))
+				shift++;
+			while (shift + bits < 32 && masks[c] >> (shift + bits) & 1)
+				bits++;
+		}
+		if (bits > 8) {
+			shift += bits - 8;
+			bits = 8;
+		}
+		
+		unsigned int maxValue = (1U << bits) - 1;
+		unpacker.masks[c] = maxValue << shift;
+		unpacker.shifts[c] = shift;
+		for (unsigned int v = 0; v < 256; v++)
+			unpacker.values[c][v] = (bits > 0) ? expandBits(v & maxValue, bits) : (c == 3) ? 0xff : 0;
+	}
+	
+	bool avx2 = false;
+#ifdef CG_X86_SIMD
+	avx2 = __builtin_cpu_supports("avx2");
+#endif
+	
+	unpacker.kernel = unpackMasked;
+	if (bytesPerPixel == 2 && masks[3] == 0 && masks[2] == 0x1fU) {
+		if (masks[0] == 0xf800U && masks[1] == 0x07e0U)
+			unpacker.kernel = unpack16Scalar<11, 6>;
+		if (masks[0] == 0x7c00U && masks[1] == 0x03e0U)
+			unpacker.kernel = unpack16Scalar<10, 5>;
+#ifdef CG_X86_SIMD
+		if (avx2 && masks[0] == 0xf800U && masks[1] == 0x07e0U)
+			unpacker.kernel = unpack16AVX2<11, 6>;
+		if (avx2 && masks[0] == 0x7c00U && masks[1] == 0x03e0U)
+			unpacker.kernel = unpack16AVX2<10, 5>;
+#endif
+	}
+	else if (bytesPerPixel == 4 && masks[3] == 0 &&
+		masks[0] == 0xff0000U && masks[1] == 0xff00U && masks[2] == 0xffU)
+		unpacker.kernel = unpackBGRX;
+}
+
+
+// Byte Streams
+// NOTE: The codecs read and write images through this interface, so that they work the same
+// on files and on memory buffers. The functions follow the conventions of the stdio functions
+// they replace. view() gives direct access to the next count bytes of a memory buffer, and
+// skips past them; streams without such a buffer return null, and must be read instead.
+struct ByteStream {
+	virtual ~ByteStream() {}
+	virtual size_t read(void *buffer, size_t size, size_t count) = 0;
+	virtual const char *view(size_t) { return 0; }
+	virtual size_t write(const void *data, size_t size, size_t count) = 0;
+	virtual int seek(long long offset, int origin) = 0;
+	virtual long long tell() = 0;
+};
+
+struct FileStream : ByteStream {
+	explicit FileStream(FILE *fptr) : fptr(fptr) {}
+	
+	size_t read(void *buffer, size_t size, size_t count) {
+		return std::fread(buffer, size, count, fptr);
+	}
+	
+	size_t write(const void *data, size_t size, size_t count) {
+		return std::fwrite(data, size, count, fptr);
+	}
+	
+	int seek(long long offset, int origin) { return CG_FSEEK(fptr, offset, origin); }
+	long long tell()                       { return CG_FTELL(fptr); }
+	
+	FILE *fptr;
+};
+
+// NOTE: A descriptor stream reads and writes a file descriptor without buffering, so that
+// nothing past the end of the image is consumed, and counts its positions from where the
+// stream started. Descriptors that cannot seek (e.g. pipes) can still skip forward, by
+// reading and discarding the skipped bytes.
+struct FdStream : ByteStream {
+	explicit FdStream(int fd) : fd(fd), position(0) {}
+	
+	size_t read(void *buffer, size_t size, size_t count) {
+		size_t total = size * count, done = 0;
+		while (done < total) {
+			long n = CG_FD_READ(fd, (char *)buffer + done, total - done);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			done += n;
+		}
+		position += done;
+		return done / size;
+	}
+	
+	size_t write(const void *data, size_t size, size_t count) {
+		size_t total = size * count, done = 0;
+		while (done < total) {
+			long n = CG_FD_WRITE(fd, (const char *)data + done, total - done);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			done += n;
+		}
+		position += done;
+		return done / size;
+	}
+	
+	int seek(long long offset, int origin) {
+		long long target;
+		if (origin == SEEK_SET)      { target = offset; }
+		else if (origin == SEEK_CUR) { target = position + offset; }
+		else                         { return -1; }
+		
+		if (target == position)
+			return 0;
+		
+		if (CG_FD_SEEK(fd, target - position, SEEK_CUR) >= 0) {
+			position = target;
+			return 0;
+		}
+		
+		if (target < position)
+			return -1;
+		
+		char buffer[PIXEL_BUFFER_SIZE];
+		while (position < target) {
+			long long chunk = target - position;
+			if (chunk > PIXEL_BUFFER_SIZE) { chunk = PIXEL_BUFFER_SIZE; }
+			if (read(buffer, 1, chunk) != (size_t)chunk)
+				return -1;
+		}
+		
+		return 0;
+	}
+	
+	long long tell() { return position; }
+	
+	int fd;
+	long long position;
+};
+
+// NOTE: A memory stream reads from a caller's buffer in place. It is writable only if it was
+// given a mutable buffer, and never grows past the end of the buffer.
+struct MemoryStream : ByteStream {
+	MemoryStream(const void *data, size_t size)
+		: data((const char *)data), out(0), size(size), position(0) {}
+	MemoryStream(void *out, size_t size)
+		: data((const char *)out), out((char *)out), size(size), position(0) {}
+	
+	size_t read(void *buffer, size_t itemSize, size_t count) {
+		size_t items = (size - position) / itemSize;
+		if (items > count) { items = count; }
+		std::memcpy(buffer, data + position, items * itemSize);
+		position += items * itemSize;
+		return items;
+	}
+	
+	const char *view(size_t count) {
+		if (count > size - position)
+			return 0;
+		const char *p = data + position;
+		position += count;
+		return p;
+	}
+	
+	size_t write(const void *bytes, size_t itemSize, size_t count) {
+		if (!out)
+			return 0;
+		size_t items = (size - position) / itemSize;
+		if (items > count) { items = count; }
+		std::memcpy(out + position, bytes, items * itemSize);
+		position += items * itemSize;
+		return items;
+	}
+	
+	int seek(long long offset, int origin) {
+		long long base =
+			(origin == SEEK_SET) ? 0 : (origin == SEEK_CUR) ? (long long)position : (long long)size;
+		if (offset < -base || offset > (long long)size - base)
+			return -1;
+		position = (size_t)(base + offset);
+		return 0;
+	}
+	
+	long long tell() { return (long long)position; }
+	
+	const char *data;
+	char *out;
+	size_t size;
+	size_t position;
+};
+
+
 // Image File Read Access
+void extractPixels(
+	const char *buffer, int count, unsigned int bytesPerPixel,
+	Extractor rx, Extractor gx, Extractor bx, Extractor ax,
+	void *&rp, void *&gp, void *&bp, void *&ap)
+{
+	for (int i = 0; i < count; i++) {
+		unsigned int pixel = 0xff000000U;
+		std::memcpy(&pixel, buffer + bytesPerPixel*i, bytesPerPixel);
+		// NOTE: The extractors increment the output buffer pointers as necessary.
+		rx(pixel, rp);
+		gx(pixel, gp);
+		bx(pixel, bp);
+		ax(pixel, ap);
+	}
+}
+
 int read24bitPixels(
-	FILE *fptr, int width, int height,
+	ByteStream &stream, int width, int height,
 	Extractor rx, Extractor gx, Extractor bx, Extractor ax,
-	void *r, void *g, void *b, void *a,
+	void *r, void *g, void *b, void *a, ptrdiff_t rowSkipBytes,
 	int &result)
 {
-	char *buffer = new char[PIXEL_BUFFER_SIZE];
+	ScratchBuffer scratch(PIXEL_BUFFER_SIZE);
+	char *buffer = scratch.data();
 	if (!buffer)
 		return result = CGRESULT_ALLOC_FAILED;
 	
-	unsigned int pixelBytesPerRow = 3 * width;
-	unsigned int padBytesPerRow = (pixelBytesPerRow % 4 == 0) ? 0 : 4 - pixelBytesPerRow % 4;
-	unsigned int bytesPerRow = pixelBytesPerRow + padBytesPerRow;
-	unsigned int totalBytes = bytesPerRow * height;
-	unsigned int totalBytesRead = 0;
+	unsigned long long pixelBytesPerRow = 3ULL * width;
+	unsigned int padBytesPerRow = (unsigned int)(bitmapRowBytes(24, width) - pixelBytesPerRow);
+	unsigned long long bytesPerRow = pixelBytesPerRow + padBytesPerRow;
+	unsigned long long totalBytes = bytesPerRow * height;
+	unsigned long long totalBytesRead = 0;
 	void *rp = r, *gp = g, *bp = b, *ap = a;
 	
 	while (totalBytesRead < totalBytes) {
-		unsigned int bytesRemaining = totalBytes - totalBytesRead;
-		unsigned int rowIndex = totalBytesRead / bytesPerRow;
-		unsigned int rowByteIndex = totalBytesRead % bytesPerRow;
-		unsigned int columnIndex = rowByteIndex / 3;
-		unsigned int bytesToRead =
-			(PIXEL_BUFFER_SIZE < bytesRemaining) ? PIXEL_BUFFER_SIZE : bytesRemaining;
+		unsigned long long bytesRemaining = totalBytes - totalBytesRead;
+		unsigned long long rowIndex = totalBytesRead / bytesPerRow;
+		unsigned long long rowByteIndex = totalBytesRead % bytesPerRow;
+		unsigned int columnIndex = (unsigned int)(rowByteIndex / 3);
+		unsigned int bytesToRead = (unsigned int)
+			((PIXEL_BUFFER_SIZE < bytesRemaining) ? PIXEL_BUFFER_SIZE : bytesRemaining);
 		int bytesExtracted = 0;
 		
 		// NOTE: This stuff is necessary because we must avoid ending the read in the middle
 		// of a field (pixel or padding).
-		unsigned int newTotalBytesRead = totalBytesRead + bytesToRead;
-		unsigned int newRowByteIndex = newTotalBytesRead % bytesPerRow;
+		unsigned long long newTotalBytesRead = totalBytesRead + bytesToRead;
+		unsigned long long newRowByteIndex = newTotalBytesRead % bytesPerRow;
 		if (newRowByteIndex < pixelBytesPerRow)              // Avoid split pixel.
 			bytesToRead -= newRowByteIndex % 3;                // Read a multiple of 3 bytes of the row.
 		else                                                 // Avoid split padding.
 			bytesToRead -= newRowByteIndex - pixelBytesPerRow; // Do not read any of the pad bytes.
 		
-		int bytesRead = std::fread(buffer, 1, bytesToRead, fptr);
+		// NOTE: Memory streams are extracted in place.
+		StatSpan readSpan(CG_STAT_READ_BITMAP);
+		const char *data = stream.view(bytesToRead);
+		int bytesRead = bytesToRead;
+		if (!data) {
+			bytesRead = stream.read(buffer, 1, bytesToRead);
+			data = buffer;
+		}
+		readSpan.count(bytesRead, 0);
+		readSpan.stop();
 		if (bytesRead != bytesToRead) {
 			result = CGRESULT_READ_ERROR;
 			goto finish;
 		}
 		
+		StatSpan extractSpan(CG_STAT_EXTRACT);
+		
 		while (bytesExtracted < bytesRead) {
+			unsigned int firstColumn = columnIndex;
 			while (columnIndex < width && bytesExtracted < bytesRead) {
 				unsigned int pixel = 0xff000000U;
-				std::memcpy(&pixel, buffer + bytesExtracted, 3);
+				std::memcpy(&pixel, data + bytesExtracted, 3);
 				// NOTE: The extractors increment the output buffer pointers as necessary.
 				rx(pixel, rp);
 				gx(pixel, gp);
@@ -445,7 +1253,11 @@ int read24bitPixels(
 				ax(pixel, ap);
 				columnIndex++;
 				bytesExtracted += 3;
+				
+				if (columnIndex == width)
+					advanceChannels(rowSkipBytes, rp, gp, bp, ap);
 			}
+			extractSpan.count(0, columnIndex - firstColumn);
 			
 			if (padBytesPerRow > 0 && bytesExtracted < bytesRead)
 				bytesExtracted += padBytesPerRow;
@@ -460,52 +1272,64 @@ int read24bitPixels(
 	result = CGRESULT_OK;
 	
 finish:
-	delete[] buffer;
 	return result;
 }
 
 int read32bitPixels(
-	FILE *fptr, int width, int height,
+	ByteStream &stream, int width, int height,
 	Extractor rx, Extractor gx, Extractor bx, Extractor ax,
-	void *r, void *g, void *b, void *a,
+	void *r, void *g, void *b, void *a, ptrdiff_t rowSkipBytes,
 	int &result)
 {
-	char *buffer = new char[PIXEL_BUFFER_SIZE];
+	ScratchBuffer scratch(PIXEL_BUFFER_SIZE);
+	char *buffer = scratch.data();
 	if (!buffer)
 		return result = CGRESULT_ALLOC_FAILED;
 	
-	unsigned int pixelBytesPerRow = 4 * width;
-	unsigned int bytesPerRow = pixelBytesPerRow;
-	unsigned int totalBytes = bytesPerRow * height;
-	unsigned int totalBytesRead = 0;
+	unsigned long long pixelBytesPerRow = 4ULL * width;
+	unsigned long long bytesPerRow = pixelBytesPerRow;
+	unsigned long long totalBytes = bytesPerRow * height;
+	unsigned long long totalBytesRead = 0;
 	void *rp = r, *gp = g, *bp = b, *ap = a;
 	
 	while (totalBytesRead < totalBytes) {
-		unsigned int bytesRemaining = totalBytes - totalBytesRead;
-		unsigned int rowIndex = totalBytesRead / bytesPerRow;
-		unsigned int rowByteIndex = totalBytesRead % bytesPerRow;
-		unsigned int columnIndex = rowByteIndex / 4;
-		unsigned int bytesToRead =
-			(PIXEL_BUFFER_SIZE < bytesRemaining) ? PIXEL_BUFFER_SIZE : bytesRemaining;
+		unsigned long long bytesRemaining = totalBytes - totalBytesRead;
+		unsigned long long rowIndex = totalBytesRead / bytesPerRow;
+		unsigned long long rowByteIndex = totalBytesRead % bytesPerRow;
+		unsigned int columnIndex = (unsigned int)(rowByteIndex / 4);
+		unsigned int bytesToRead = (unsigned int)
+			((PIXEL_BUFFER_SIZE < bytesRemaining) ? PIXEL_BUFFER_SIZE : bytesRemaining);
 		int bytesExtracted = 0;
 		
 		// NOTE: This stuff is necessary because we must avoid ending the read in the middle
 		// of a pixel. If the buffer size was a multiple of 4, this would be redundant,
 		// but it's more robust to include it.
-		unsigned int newTotalBytesRead = totalBytesRead + bytesToRead;
-		unsigned int newRowByteIndex = newTotalBytesRead % bytesPerRow;
+		unsigned long long newTotalBytesRead = totalBytesRead + bytesToRead;
+		unsigned long long newRowByteIndex = newTotalBytesRead % bytesPerRow;
 		bytesToRead -= newRowByteIndex % 4; // Read a multiple of 4 bytes of the row.
 		
-		int bytesRead = std::fread(buffer, 1, bytesToRead, fptr);
+		// NOTE: Memory streams are extracted in place.
+		StatSpan readSpan(CG_STAT_READ_BITMAP);
+		const char *data = stream.view(bytesToRead);
+		int bytesRead = bytesToRead;
+		if (!data) {
+			bytesRead = stream.read(buffer, 1, bytesToRead);
+			data = buffer;
+		}
+		readSpan.count(bytesRead, 0);
+		readSpan.stop();
 		if (bytesRead != bytesToRead) {
 			result = CGRESULT_READ_ERROR;
 			goto finish;
 		}
 		
+		StatSpan extractSpan(CG_STAT_EXTRACT);
+		
 		while (bytesExtracted < bytesRead) {
+			unsigned int firstColumn = columnIndex;
 			while (columnIndex < width && bytesExtracted < bytesRead) {
 				unsigned int pixel = 0;
-				std::memcpy(&pixel, buffer + bytesExtracted, 4);
+				std::memcpy(&pixel, data + bytesExtracted, 4);
 				// NOTE: The extractors increment the output buffer pointers as necessary.
 				rx(pixel, rp);
 				gx(pixel, gp);
@@ -513,7 +1337,11 @@ int read32bitPixels(
 				ax(pixel, ap);
 				columnIndex++;
 				bytesExtracted += 4;
+				
+				if (columnIndex == width)
+					advanceChannels(rowSkipBytes, rp, gp, bp, ap);
 			}
+			extractSpan.count(0, columnIndex - firstColumn);
 			
 			rowIndex++;
 			columnIndex = 0;
@@ -525,104 +1353,242 @@ int read32bitPixels(
 	result = CGRESULT_OK;
 	
 finish:
-	delete[] buffer;
 	return result;
 }
 
-int readBMP(
-	FILE *fptr, int dataFormat, int maxWidth, int maxHeight,
-	int &width, int &height, void *r, void *g, void *b, void *a,
-	int &result)
-{
+// NOTE: The bytes per pixel are zero for indexed-color bitmaps. Their palette entries are
+// stored like the pixels of a 32-bit bitmap, opaque, and the entries that the file does not
+// define are opaque black. The bitmap size is only known for compressed bitmaps. The masks of
+// bit field bitmaps are given in the order red, green, blue and alpha. The file bytes are the
+// size of the image in the file, which is the file size in the header unless the bitmap array
+// ends after it.
+struct BMPInfo {
+	int width;
+	int height;
+	unsigned int bitsPerPixel;
+	unsigned int bytesPerPixel;
+	unsigned int compression;
+	unsigned int bitmapSize;
+	unsigned long long fileBytes;
+	bool topDown;
+	unsigned int masks[4];
+	unsigned int palette[256];
+};
+
+// NOTE: The bits of each mask must be contiguous and fit in the pixel.
+bool validBitmasks(const unsigned int *masks, unsigned int bitsPerPixel) {
+	unsigned int used = 0;
+	for (int c = 0; c < 4; c++) {
+		unsigned int mask = masks[c];
+		if (bitsPerPixel < 32 && mask >> bitsPerPixel)
+			return false;
+		if (mask & used)
+			return false;
+		used |= mask;
+		
+		if (mask) {
+			while (!(mask & 1))
+				mask >>= 1;
+			if (mask & (mask + 1))
+				return false;
+		}
+	}
+	return masks[0] || masks[1] || masks[2];
+}
+
+// NOTE: On success, the file position is at the start of the bitmap array.
+int readBMPHeader(ByteStream &stream, int maxWidth, int maxHeight, BMPInfo &info, int &result) {
+	StatSpan span(CG_STAT_READ_HEADER);
 	unsigned int field = 0;
 	int fieldsRead;
 	
 	// Read file header.
-	fieldsRead = std::fread(&field, 2, 1, fptr); // 0: Read "BM".
+	fieldsRead = stream.read(&field, 2, 1); // 0: Read "BM".
 	if (fieldsRead != 1 || field != 0x4d42U)
 		return result = CGRESULT_INVALID_FORMAT;
 	
 	unsigned int fileSize = 0;
-	fieldsRead = std::fread(&fileSize, 4, 1, fptr); // 2: Read file size.
+	fieldsRead = stream.read(&fileSize, 4, 1); // 2: Read file size.
 	if (fieldsRead != 1)
 		return result = CGRESULT_INVALID_FORMAT;
 	
-	fieldsRead = std::fread(&field, 4, 1, fptr); // 6: Read reserved fields.
+	fieldsRead = stream.read(&field, 4, 1); // 6: Read reserved fields.
 	if (fieldsRead != 1)
 		return result = CGRESULT_INVALID_FORMAT;
 	
 	unsigned int bitmapOffset = 0;
-	fieldsRead = std::fread(&bitmapOffset, 4, 1, fptr); // 10: Read file offset to bitmap array.
+	fieldsRead = stream.read(&bitmapOffset, 4, 1); // 10: Read file offset to bitmap array.
 	if (fieldsRead != 1)
 		return result = CGRESULT_INVALID_FORMAT;
 	
 	// Read DIB header.
 	unsigned int dibHeaderSize = 0;
-	fieldsRead = std::fread(&dibHeaderSize, 4, 1, fptr); // 14: Read DIB header size.
-	if (fieldsRead != 1 || dibHeaderSize != 40)
+	fieldsRead = stream.read(&dibHeaderSize, 4, 1); // 14: Read DIB header size.
+	// NOTE: The headers of 40, 52, 56, 108 and 124 bytes are BITMAPINFOHEADER, its versions
+	// with three or four bit masks, BITMAPV4HEADER and BITMAPV5HEADER. The fields past the bit
+	// masks (color space, gamma and ICC profile) are skipped.
+	if (fieldsRead != 1 ||
+		(dibHeaderSize != 40 && dibHeaderSize != 52 && dibHeaderSize != 56 &&
+		dibHeaderSize != 108 && dibHeaderSize != 124))
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	
-	width = 0;
-	fieldsRead = std::fread(&width, 4, 1, fptr); // 18: Read image width.
+	int width = 0;
+	fieldsRead = stream.read(&width, 4, 1); // 18: Read image width.
 	if (fieldsRead != 1 || width <= 0)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	if (width > maxWidth)
 		return result = CGRESULT_BAD_DIMENSION;
 	
-	height = 0;
-	fieldsRead = std::fread(&height, 4, 1, fptr); // 22: Read image height.
-	if (fieldsRead != 1 || height <= 0)
+	// NOTE: A negative height means that the rows are stored top-to-bottom.
+	int height = 0;
+	fieldsRead = stream.read(&height, 4, 1); // 22: Read image height.
+	if (fieldsRead != 1 || height == 0 || height == -0x7fffffff - 1)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	bool topDown = height < 0;
+	if (topDown)
+		height = -height;
 	if (height > maxHeight)
 		return result = CGRESULT_BAD_DIMENSION;
 	
-	fieldsRead = std::fread(&field, 2, 1, fptr); // 26: Read "number of color planes".
+	fieldsRead = stream.read(&field, 2, 1); // 26: Read "number of color planes".
 	if (fieldsRead != 1)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	
 	unsigned int bitsPerPixel = 0;
-	fieldsRead = std::fread(&bitsPerPixel, 2, 1, fptr); // 28: Read bits per pixel.
-	if (fieldsRead != 1 || bitsPerPixel != 24 && bitsPerPixel != 32)
+	fieldsRead = stream.read(&bitsPerPixel, 2, 1); // 28: Read bits per pixel.
+	if (fieldsRead != 1 ||
+		(bitsPerPixel != 1 && bitsPerPixel != 4 && bitsPerPixel != 8 &&
+		bitsPerPixel != 16 && bitsPerPixel != 24 && bitsPerPixel != 32))
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
-	unsigned int bytesPerPixel = bitsPerPixel / 8;
+	if (bitmapRowBytes(bitsPerPixel, width) > MAX_BITMAP_SIZE / height)
+		return result = CGRESULT_BAD_DIMENSION;
 	
 	unsigned int compressionMethod = 999999;
-	fieldsRead = std::fread(&compressionMethod, 4, 1, fptr); // 30: Read compression method.
-	if (fieldsRead != 1 || compressionMethod != 0) // BI_RGB
+	fieldsRead = stream.read(&compressionMethod, 4, 1); // 30: Read compression method.
+	if (fieldsRead != 1)
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	
+	// NOTE: RLE bitmaps are always stored bottom-to-top.
+	bool rle8 = compressionMethod == BMP_COMPRESSION_RLE8 && bitsPerPixel == 8;
+	bool rle4 = compressionMethod == BMP_COMPRESSION_RLE4 && bitsPerPixel == 4;
+	bool bitfields = compressionMethod == BMP_COMPRESSION_BITFIELDS &&
+		(bitsPerPixel == 16 || bitsPerPixel == 32);
+	if (compressionMethod != BMP_COMPRESSION_NONE && !bitfields && (topDown || (!rle8 && !rle4)))
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	
 	unsigned int bitmapSize = 0;
-	fieldsRead = std::fread(&bitmapSize, 4, 1, fptr); // 34: Read bitmap size.
+	fieldsRead = stream.read(&bitmapSize, 4, 1); // 34: Read bitmap size.
 	if (fieldsRead != 1)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	if ((rle8 || rle4) && bitmapSize == 0)
+		return result = CGRESULT_INVALID_FORMAT;
 	
-	fieldsRead = std::fread(&field, 4, 1, fptr); // 38: Read horizontal resolution.
+	fieldsRead = stream.read(&field, 4, 1); // 38: Read horizontal resolution.
 	if (fieldsRead != 1)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	
-	fieldsRead = std::fread(&field, 4, 1, fptr); // 42: Read vertical resolution.
+	fieldsRead = stream.read(&field, 4, 1); // 42: Read vertical resolution.
 	if (fieldsRead != 1)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	
-	fieldsRead = std::fread(&field, 4, 1, fptr); // 46: Read palette size.
+	unsigned int paletteSize = 0;
+	fieldsRead = stream.read(&paletteSize, 4, 1); // 46: Read palette size.
 	if (fieldsRead != 1)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	
-	fieldsRead = std::fread(&field, 4, 1, fptr); // 50: Read "number of important colors".
+	fieldsRead = stream.read(&field, 4, 1); // 50: Read "number of important colors".
 	if (fieldsRead != 1)
 		return result = CGRESULT_UNSUPPORTED_FORMAT;
 	
-	// 54: End of Headers.
+	unsigned int headerBytes = 54;
 	
-	// Read pixel data.
-	if (bitmapOffset > 54) {
-		int fseekResult = std::fseek(fptr, bitmapOffset - 54, SEEK_CUR);
+	// NOTE: The bit masks follow the fields above in the larger headers, and follow a 40-byte
+	// header when the compression method is BI_BITFIELDS. They are only used for bit field
+	// bitmaps. A 16-bit bitmap without them has five bits per channel.
+	unsigned int masks[4] = { 0, 0, 0, 0 };
+	unsigned int maskCount = (dibHeaderSize >= 56) ? 4 : (dibHeaderSize == 52 || bitfields) ? 3 : 0;
+	if (maskCount > 0) {
+		fieldsRead = stream.read(masks, 4, maskCount); // 54: Read bit masks.
+		if (fieldsRead != (int)maskCount)
+			return result = CGRESULT_UNSUPPORTED_FORMAT;
+		headerBytes += 4 * maskCount;
+	}
+	
+	if (dibHeaderSize > 40 + 4 * maskCount) {
+		unsigned int skipped = dibHeaderSize - 40 - 4 * maskCount;
+		int fseekResult = stream.seek(skipped, SEEK_CUR);
 		if (fseekResult)
 			return result = CGRESULT_SEEK_ERROR;
+		headerBytes += skipped;
 	}
 	
-	Extractor rx, gx, bx, ax;
+	if (bitsPerPixel == 16 && !bitfields) {
+		masks[0] = 0x7c00U;
+		masks[1] = 0x03e0U;
+		masks[2] = 0x001fU;
+		masks[3] = 0;
+		bitfields = true;
+	}
+	
+	if (bitfields) {
+		if (!validBitmasks(masks, bitsPerPixel))
+			return result = CGRESULT_UNSUPPORTED_FORMAT;
+		compressionMethod = BMP_COMPRESSION_BITFIELDS;
+		if (bitsPerPixel == 32 && masks[0] == 0xff0000U && masks[1] == 0xff00U &&
+			masks[2] == 0xffU && masks[3] == 0xff000000U)
+			compressionMethod = BMP_COMPRESSION_NONE;
+	}
+	
+	// End of Headers.
+	// NOTE: A palette size of zero means that an indexed-color bitmap has the full palette. The
+	// palette of a direct color bitmap is only a hint for display, and is skipped.
+	for (int i = 0; i < 256; i++)
+		info.palette[i] = 0xff000000U;
+	
+	if (bitsPerPixel <= 8) {
+		unsigned int maxPaletteSize = 1U << bitsPerPixel;
+		if (paletteSize == 0)
+			paletteSize = maxPaletteSize;
+		if (paletteSize > maxPaletteSize)
+			return result = CGRESULT_UNSUPPORTED_FORMAT;
+		
+		fieldsRead = stream.read(info.palette, 4, paletteSize); // 54: Read palette.
+		if (fieldsRead != (int)paletteSize)
+			return result = CGRESULT_UNSUPPORTED_FORMAT;
+		for (unsigned int i = 0; i < paletteSize; i++)
+			info.palette[i] |= 0xff000000U;
+		headerBytes += 4 * paletteSize;
+	}
+	
+	// Skip to pixel data.
+	if (bitmapOffset > headerBytes) {
+		int fseekResult = stream.seek(bitmapOffset - headerBytes, SEEK_CUR);
+		if (fseekResult)
+			return result = CGRESULT_SEEK_ERROR;
+	}
+	
+	info.width = width;
+	info.height = height;
+	info.bitsPerPixel = bitsPerPixel;
+	info.bytesPerPixel = (bitsPerPixel <= 8) ? 0 : bitsPerPixel / 8;
+	info.compression = compressionMethod;
+	info.bitmapSize = (rle8 || rle4) ? bitmapSize : 0;
+	info.topDown = topDown;
 	
+	unsigned long long bitmapEnd = (bitmapOffset > headerBytes) ? bitmapOffset : headerBytes;
+	bitmapEnd += (rle8 || rle4) ? bitmapSize : bitmapRowBytes(bitsPerPixel, width) * height;
+	info.fileBytes = (fileSize > bitmapEnd) ? fileSize : bitmapEnd;
+	
+	for (int c = 0; c < 4; c++)
+		info.masks[c] = (compressionMethod == BMP_COMPRESSION_BITFIELDS) ? masks[c] : 0;
+	return result = CGRESULT_OK;
+}
+
+int selectExtractors(
+	int dataFormat, const void *r, const void *g, const void *b, const void *a,
+	Extractor &rx, Extractor &gx, Extractor &bx, Extractor &ax,
+	int &result)
+{
 	switch (dataFormat) {
 	case CG_DATA_FORMAT_RGB:
 		rx = redExtractor;
@@ -657,54 +1623,673 @@ int readBMP(
 	if (!b) { bx = nopExtractor; }
 	if (!a) { ax = nopExtractor; }
 	
-	switch (bytesPerPixel) {
-	case 3:
-		read24bitPixels(fptr, width, height, rx, gx, bx, ax, r, g, b, a, result);
-		break;
-	case 4:
-		read32bitPixels(fptr, width, height, rx, gx, bx, ax, r, g, b, a, result);
-		break;
-	default:
-		return result = CGRESULT_UNSPECIFIED;
-	}
-	
-	return result;
+	return result = CGRESULT_OK;
+}
+
+inline bool rleCompressed(const BMPInfo &info) {
+	return info.compression == BMP_COMPRESSION_RLE8 || info.compression == BMP_COMPRESSION_RLE4;
+}
+
+// NOTE: RLE bitmaps are decoded into rows of one palette index per byte.
+unsigned int indexBits(const BMPInfo &info) {
+	return (rleCompressed(info)) ? 8 : info.bitsPerPixel;
+}
+
+// NOTE: The pixels of a row are packed into bytes from the most significant bit down.
+inline unsigned int paletteIndex(const uchar *row, int x, unsigned int bitsPerPixel) {
+	size_t bit = (size_t)x * bitsPerPixel;
+	return (row[bit >> 3] >> (8 - bitsPerPixel - (bit & 7))) & ((1U << bitsPerPixel) - 1);
+}
+
+typedef void (*IndexExpander)(
+	const uchar *row, int first, int count, const void *table, void *&channel);
+
+template<typename T, unsigned int BitsPerPixel>
+void expandIndexedChannel(
+	const uchar *row, int first, int count, const void *table, void *&channel)
+{
+	const T *values = (const T *)table;
+	T *out = (T *)channel;
+	for (int x = first; x < first + count; x++)
+		*out++ = values[paletteIndex(row, x, BitsPerPixel)];
+	channel = out;
+}
+
+// NOTE: The palette of an indexed-color bitmap is converted once per read, by the same extractors
+// as the pixels of a direct color bitmap, into a table of values for every channel, so that the
+// same tables serve each row batch whichever channels it requests. Each pixel then costs one
+// table lookup per requested channel, whatever the data format.
+struct PaletteTables {
+	IndexExpander expander;
+	double values[4][256];
+};
+
+int buildPaletteTables(const BMPInfo &info, int dataFormat, PaletteTables &tables, int &result) {
+	Extractor x[4];
+	const double (*v)[256] = tables.values;
+	selectExtractors(dataFormat, v[0], v[1], v[2], v[3], x[0], x[1], x[2], x[3], result);
+	if (result != CGRESULT_OK)
+		return result;
+	
+	bool bytes = channelSize(dataFormat) == 1;
+	switch (indexBits(info)) {
+	case 1:
+		tables.expander = (bytes) ? expandIndexedChannel<uchar, 1> : expandIndexedChannel<double, 1>;
+		break;
+	case 4:
+		tables.expander = (bytes) ? expandIndexedChannel<uchar, 4> : expandIndexedChannel<double, 4>;
+		break;
+	case 8:
+		tables.expander = (bytes) ? expandIndexedChannel<uchar, 8> : expandIndexedChannel<double, 8>;
+		break;
+	default:
+		return result = CGRESULT_UNSPECIFIED;
+	}
+	
+	StatSpan span(CG_STAT_CONVERT);
+	int entries = 1 << info.bitsPerPixel;
+	span.count(0, entries);
+	for (int c = 0; c < 4; c++) {
+		void *p = tables.values[c];
+		for (int i = 0; i < entries; i++)
+			x[c](info.palette[i], p);
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+void expandIndexedPixels(
+	const PaletteTables &tables, const uchar *row, int first, int count,
+	void *&rp, void *&gp, void *&bp, void *&ap)
+{
+	if (rp) { tables.expander(row, first, count, tables.values[0], rp); }
+	if (gp) { tables.expander(row, first, count, tables.values[1], gp); }
+	if (bp) { tables.expander(row, first, count, tables.values[2], bp); }
+	if (ap) { tables.expander(row, first, count, tables.values[3], ap); }
+}
+
+// NOTE: An RLE decoder reads the compressed bitmap through its own buffer, but never past the
+// bitmap size given in the header, so that a descriptor stream consumes only the bytes of the
+// image. Its state carries over from one row to the next: a delta that moves down leaves rows
+// to skip, and the column to start the last of them at.
+struct RLEDecoder {
+	void reset(const BMPInfo &info) {
+		remaining = info.bitmapSize;
+		data = 0;
+		available = 0;
+		skipRows = 0;
+		skipColumns = 0;
+		ended = false;
+	}
+	
+	unsigned long long remaining;
+	const uchar *data;
+	size_t available;
+	int skipRows;
+	int skipColumns;
+	bool ended;
+	uchar buffer[PIXEL_BUFFER_SIZE];
+};
+
+// NOTE: Copies the next count bytes of the compressed bitmap to out, or skips them if out is null.
+bool readRLEBytes(ByteStream &stream, RLEDecoder &decoder, uchar *out, size_t count) {
+	while (count > 0) {
+		if (decoder.available == 0) {
+			size_t chunk =
+				(decoder.remaining < PIXEL_BUFFER_SIZE) ? (size_t)decoder.remaining : PIXEL_BUFFER_SIZE;
+			if (chunk == 0)
+				return false;
+			
+			StatSpan readSpan(CG_STAT_READ_BITMAP);
+			readSpan.count(chunk, 0);
+			decoder.data = (const uchar *)stream.view(chunk);
+			if (!decoder.data) {
+				if (stream.read(decoder.buffer, 1, chunk) != chunk)
+					return false;
+				decoder.data = decoder.buffer;
+			}
+			decoder.available = chunk;
+			decoder.remaining -= chunk;
+		}
+		
+		size_t n = (count < decoder.available) ? count : decoder.available;
+		if (out) {
+			std::memcpy(out, decoder.data, n);
+			out += n;
+		}
+		decoder.data += n;
+		decoder.available -= n;
+		count -= n;
+	}
+	
+	return true;
+}
+
+// NOTE: Decodes the next row of an RLE bitmap into one palette index per byte. Runs are filled
+// with memset, so long runs cost little more than their bytes. Pixels outside the row, which
+// only broken files encode, are dropped.
+int decodeRLERow(
+	ByteStream &stream, const BMPInfo &info, RLEDecoder &decoder, uchar *indices, int &result)
+{
+	int width = info.width;
+	std::memset(indices, 0, width);
+	
+	if (decoder.ended)
+		return result = CGRESULT_OK;
+	if (decoder.skipRows > 0) {
+		decoder.skipRows--;
+		return result = CGRESULT_OK;
+	}
+	
+	bool rle4 = info.compression == BMP_COMPRESSION_RLE4;
+	int x = decoder.skipColumns;
+	decoder.skipColumns = 0;
+	
+	for (;;) {
+		uchar code[2];
+		if (!readRLEBytes(stream, decoder, code, 2))
+			return result = CGRESULT_READ_ERROR;
+		
+		// Encoded mode: a run of code[0] pixels.
+		if (code[0] > 0) {
+			int n = (code[0] < width - x) ? code[0] : width - x;
+			if (!rle4)
+				std::memset(indices + x, code[1], n);
+			else if (code[1] >> 4 == (code[1] & 0xfU))
+				std::memset(indices + x, code[1] & 0xfU, n);
+			else {
+				for (int i = 0; i < n; i++)
+					indices[x + i] = (i & 1) ? code[1] & 0xfU : code[1] >> 4;
+			}
+			x += n;
+			continue;
+		}
+		
+		switch (code[1]) {
+		case 0: // End of line.
+			return result = CGRESULT_OK;
+		case 1: // End of bitmap.
+			decoder.ended = true;
+			return result = CGRESULT_OK;
+		case 2: { // Delta.
+			uchar delta[2];
+			if (!readRLEBytes(stream, decoder, delta, 2))
+				return result = CGRESULT_READ_ERROR;
+			x = (delta[0] < width - x) ? x + delta[0] : width;
+			if (delta[1] > 0) {
+				decoder.skipRows = delta[1] - 1;
+				decoder.skipColumns = x;
+				return result = CGRESULT_OK;
+			}
+			break;
+		}
+		default: { // Absolute mode: code[1] literal pixels, padded to a 16-bit boundary.
+			uchar literal[256];
+			int count = code[1];
+			size_t bytes = (rle4) ? (count + 1) / 2 : count;
+			if (!readRLEBytes(stream, decoder, literal, (bytes + 1) & ~(size_t)1))
+				return result = CGRESULT_READ_ERROR;
+			
+			int n = (count < width - x) ? count : width - x;
+			if (!rle4)
+				std::memcpy(indices + x, literal, n);
+			else {
+				for (int i = 0; i < n; i++)
+					indices[x + i] = (i & 1) ? literal[i / 2] & 0xfU : literal[i / 2] >> 4;
+			}
+			x += n;
+		}
+		}
+	}
+}
+
+int readIndexedPixels(
+	ByteStream &stream, const BMPInfo &info, RLEDecoder &decoder, const PaletteTables &tables,
+	int height, void *r, void *g, void *b, void *a, ptrdiff_t rowSkipBytes,
+	int &result)
+{
+	size_t bytesPerRow = (size_t)bitmapRowBytes(info.bitsPerPixel, info.width);
+	ScratchBuffer scratch((size_t)bitmapRowBytes(indexBits(info), info.width));
+	uchar *buffer = (uchar *)scratch.data();
+	if (!buffer)
+		return result = CGRESULT_ALLOC_FAILED;
+	
+	void *rp = r, *gp = g, *bp = b, *ap = a;
+	
+	for (int row = 0; row < height; row++) {
+		const uchar *src = buffer;
+		if (rleCompressed(info)) {
+			if (decodeRLERow(stream, info, decoder, buffer, result) != CGRESULT_OK)
+				return result;
+		}
+		else {
+			// NOTE: Memory streams are expanded in place.
+			StatSpan readSpan(CG_STAT_READ_BITMAP);
+			readSpan.count(bytesPerRow, 0);
+			src = (const uchar *)stream.view(bytesPerRow);
+			if (!src) {
+				if (stream.read(buffer, 1, bytesPerRow) != bytesPerRow)
+					return result = CGRESULT_READ_ERROR;
+				src = buffer;
+			}
+		}
+		
+		StatSpan extractSpan(CG_STAT_EXTRACT);
+		extractSpan.count(0, info.width);
+		expandIndexedPixels(tables, src, 0, info.width, rp, gp, bp, ap);
+		advanceChannels(rowSkipBytes, rp, gp, bp, ap);
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+// NOTE: Each row is unpacked into 32-bit pixels before it is extracted.
+int readMaskedPixels(
+	ByteStream &stream, const BMPInfo &info, int dataFormat, int height,
+	void *r, void *g, void *b, void *a, ptrdiff_t rowSkipBytes,
+	int &result)
+{
+	Extractor rx, gx, bx, ax;
+	if (selectExtractors(dataFormat, r, g, b, a, rx, gx, bx, ax, result) != CGRESULT_OK)
+		return result;
+	
+	BitfieldUnpacker unpacker;
+	initBitfieldUnpacker(info.masks, info.bytesPerPixel, unpacker);
+	
+	size_t bytesPerRow = (size_t)bitmapRowBytes(info.bitsPerPixel, info.width);
+	ScratchBuffer scratch(bytesPerRow + 4 * (size_t)info.width);
+	uchar *buffer = (uchar *)scratch.data();
+	if (!buffer)
+		return result = CGRESULT_ALLOC_FAILED;
+	uchar *pixels = buffer + bytesPerRow;
+	
+	void *rp = r, *gp = g, *bp = b, *ap = a;
+	
+	for (int row = 0; row < height; row++) {
+		// NOTE: Memory streams are unpacked in place.
+		StatSpan readSpan(CG_STAT_READ_BITMAP);
+		readSpan.count(bytesPerRow, 0);
+		const uchar *src = (const uchar *)stream.view(bytesPerRow);
+		if (!src) {
+			if (stream.read(buffer, 1, bytesPerRow) != bytesPerRow)
+				return result = CGRESULT_READ_ERROR;
+			src = buffer;
+		}
+		readSpan.stop();
+		
+		StatSpan extractSpan(CG_STAT_EXTRACT);
+		extractSpan.count(0, info.width);
+		unpacker.kernel(unpacker, src, pixels, info.width);
+		extractPixels((const char *)pixels, info.width, 4, rx, gx, bx, ax, rp, gp, bp, ap);
+		advanceChannels(rowSkipBytes, rp, gp, bp, ap);
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+// NOTE: Reads the next rowCount rows of the bitmap array, starting at the current file position.
+// The decoder is only used by RLE bitmaps, and must be reset before their first row. The palette
+// tables are only used by indexed-color bitmaps, and must be built before their first row.
+int readBMPRows(
+	ByteStream &stream, const BMPInfo &info, RLEDecoder &decoder, const PaletteTables &tables,
+	int dataFormat, int rowCount, void *r, void *g, void *b, void *a, ptrdiff_t rowSkipBytes,
+	int &result)
+{
+	if (info.bitsPerPixel <= 8) {
+		return readIndexedPixels(
+			stream, info, decoder, tables, rowCount, r, g, b, a, rowSkipBytes, result);
+	}
+	if (info.compression == BMP_COMPRESSION_BITFIELDS) {
+		return readMaskedPixels(
+			stream, info, dataFormat, rowCount, r, g, b, a, rowSkipBytes, result);
+	}
+	
+	Extractor rx, gx, bx, ax;
+	if (selectExtractors(dataFormat, r, g, b, a, rx, gx, bx, ax, result) != CGRESULT_OK)
+		return result;
+	
+	switch (info.bytesPerPixel) {
+	case 3:
+		read24bitPixels(stream, info.width, rowCount, rx, gx, bx, ax, r, g, b, a, rowSkipBytes, result);
+		break;
+	case 4:
+		read32bitPixels(stream, info.width, rowCount, rx, gx, bx, ax, r, g, b, a, rowSkipBytes, result);
+		break;
+	default:
+		return result = CGRESULT_UNSPECIFIED;
+	}
+	
+	return result;
+}
+
+// NOTE: Seeks to each row of the region and reads only the bytes of its column span. With a
+// top-down origin, y is counted from the top of the image.
+int readBMPRegion(
+	ByteStream &stream, int dataFormat, int x, int y, int width, int height,
+	void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	const int maxSize = 0x7fffffff;
+	BMPInfo info;
+	if (readBMPHeader(stream, maxSize, maxSize, info, result) != CGRESULT_OK)
+		return result;
+	
+	if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+		width > info.width - x || height > info.height - y)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	bool topDownOutput = (flags & CG_FLAG_TOP_DOWN) != 0;
+	if (topDownOutput)
+		y = info.height - y - height;
+	
+	RowLayout layout;
+	if (rowLayout(dataFormat, width, height, rowStride, topDownOutput, layout, result) != CGRESULT_OK)
+		return result;
+	
+	Extractor rx, gx, bx, ax;
+	if (selectExtractors(dataFormat, r, g, b, a, rx, gx, bx, ax, result) != CGRESULT_OK)
+		return result;
+	
+	// NOTE: The span of an indexed-color row starts at the byte that holds its first pixel.
+	PaletteTables tables;
+	bool indexed = info.bitsPerPixel <= 8;
+	if (indexed && buildPaletteTables(info, dataFormat, tables, result) != CGRESULT_OK)
+		return result;
+	
+	// NOTE: The span of a bit field row is unpacked after the read span in the scratch buffer.
+	BitfieldUnpacker unpacker;
+	bool masked = info.compression == BMP_COMPRESSION_BITFIELDS;
+	if (masked) { initBitfieldUnpacker(info.masks, info.bytesPerPixel, unpacker); }
+	
+	long long bitmapOffset = stream.tell();
+	if (bitmapOffset < 0)
+		return result = CGRESULT_SEEK_ERROR;
+	
+	unsigned int bitsPerPixel = info.bitsPerPixel;
+	unsigned long long bytesPerRow = bitmapRowBytes(bitsPerPixel, info.width);
+	unsigned long long firstBit = (unsigned long long)bitsPerPixel * x;
+	size_t spanBytes = (size_t)((firstBit % 8 + (unsigned long long)bitsPerPixel * width + 7) / 8);
+	int firstPixel = (int)(firstBit % 8 / bitsPerPixel);
+	void *rp = r, *gp = g, *bp = b, *ap = a;
+	advanceChannels(layout.first, rp, gp, bp, ap);
+	
+	// NOTE: The rows of an RLE bitmap cannot be reached by seeking, so all the rows below the
+	// region are decoded as well, and the span is taken from each decoded row.
+	RLEDecoder decoder;
+	bool rle = rleCompressed(info);
+	if (rle) {
+		decoder.reset(info);
+		spanBytes = info.width;
+		firstPixel = x;
+	}
+	
+	ScratchBuffer scratch(spanBytes + ((masked) ? 4 * (size_t)width : 0));
+	char *buffer = scratch.data();
+	if (!buffer)
+		return result = CGRESULT_ALLOC_FAILED;
+	char *pixels = buffer + spanBytes;
+	
+	result = CGRESULT_OK;
+	
+	for (int row = (rle) ? 0 : y; row < y + height; row++) {
+		const char *span = buffer;
+		if (rle) {
+			if (decodeRLERow(stream, info, decoder, (uchar *)buffer, result) != CGRESULT_OK)
+				break;
+			if (row < y)
+				continue;
+		}
+		else {
+			int fileRow = (info.topDown) ? info.height - 1 - row : row;
+			long long spanOffset =
+				bitmapOffset + (long long)(bytesPerRow * fileRow) + (long long)(firstBit / 8);
+			
+			if (stream.seek(spanOffset, SEEK_SET)) {
+				result = CGRESULT_SEEK_ERROR;
+				break;
+			}
+			
+			StatSpan readSpan(CG_STAT_READ_BITMAP);
+			readSpan.count(spanBytes, 0);
+			span = stream.view(spanBytes);
+			if (!span) {
+				if (stream.read(buffer, 1, spanBytes) != spanBytes) {
+					result = CGRESULT_READ_ERROR;
+					break;
+				}
+				span = buffer;
+			}
+		}
+		
+		StatSpan extractSpan(CG_STAT_EXTRACT);
+		extractSpan.count(0, width);
+		if (indexed)
+			expandIndexedPixels(tables, (const uchar *)span, firstPixel, width, rp, gp, bp, ap);
+		else if (masked) {
+			unpacker.kernel(unpacker, (const uchar *)span, (uchar *)pixels, width);
+			extractPixels(pixels, width, 4, rx, gx, bx, ax, rp, gp, bp, ap);
+		}
+		else
+			extractPixels(span, width, info.bytesPerPixel, rx, gx, bx, ax, rp, gp, bp, ap);
+		advanceChannels(layout.skip, rp, gp, bp, ap);
+	}
+	
+	return result;
+}
+
+// NOTE: Averages each block of factor x factor pixels as it is read, so that the extractors
+// (and any color conversion) run once per output pixel. The blocks at the right and top
+// edges of the image may be smaller, and are averaged over the pixels they contain. The rows
+// of a top-down bitmap are decimated in file order and stored from the last output row up.
+int readBMPDecimated(
+	ByteStream &stream, int dataFormat, int factor, int maxWidth, int maxHeight,
+	int &width, int &height, void *r, void *g, void *b, void *a,
+	int &result)
+{
+	const int maxSize = 0x7fffffff;
+	BMPInfo info;
+	if (readBMPHeader(stream, maxSize, maxSize, info, result) != CGRESULT_OK)
+		return result;
+	
+	int outWidth = (info.width + factor - 1) / factor;
+	int outHeight = (info.height + factor - 1) / factor;
+	if (outWidth > maxWidth || outHeight > maxHeight)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	Extractor rx, gx, bx, ax;
+	if (selectExtractors(dataFormat, r, g, b, a, rx, gx, bx, ax, result) != CGRESULT_OK)
+		return result;
+	
+	unsigned int bytesPerPixel = info.bytesPerPixel;
+	unsigned int bitsPerIndex = indexBits(info);
+	size_t bytesPerRow = (size_t)bitmapRowBytes(bitsPerIndex, info.width);
+	void *rp = r, *gp = g, *bp = b, *ap = a;
+	
+	// NOTE: Bit field rows are unpacked and summed as 32-bit pixels.
+	BitfieldUnpacker unpacker;
+	bool masked = info.compression == BMP_COMPRESSION_BITFIELDS;
+	if (masked) {
+		initBitfieldUnpacker(info.masks, bytesPerPixel, unpacker);
+		bytesPerPixel = 4;
+	}
+	
+	RLEDecoder decoder;
+	bool rle = rleCompressed(info);
+	if (rle) { decoder.reset(info); }
+	
+	RowLayout layout;
+	rowLayout(dataFormat, outWidth, outHeight, 0, info.topDown, layout, result);
+	advanceChannels(layout.first, rp, gp, bp, ap);
+	
+	ScratchBuffer scratch(bytesPerRow + ((masked) ? 4 * (size_t)info.width : 0));
+	uchar *buffer = (uchar *)scratch.data();
+	uchar *pixels = buffer + bytesPerRow;
+	unsigned int *sums = new unsigned int[4 * outWidth];
+	if (!buffer || !sums) {
+		result = CGRESULT_ALLOC_FAILED;
+		goto finish;
+	}
+	
+	for (int i = 0; i < outHeight; i++) {
+		int outY = (info.topDown) ? outHeight - 1 - i : i;
+		int blockRows = (info.height - outY*factor < factor) ? info.height - outY*factor : factor;
+		std::memset(sums, 0, 4 * outWidth * sizeof(unsigned int));
+		
+		for (int row = 0; row < blockRows; row++) {
+			const uchar *src = buffer;
+			if (rle) {
+				if (decodeRLERow(stream, info, decoder, buffer, result) != CGRESULT_OK)
+					goto finish;
+			}
+			else {
+				StatSpan readSpan(CG_STAT_READ_BITMAP);
+				readSpan.count(bytesPerRow, 0);
+				src = (const uchar *)stream.view(bytesPerRow);
+				if (!src) {
+					if (stream.read(buffer, 1, bytesPerRow) != bytesPerRow) {
+						result = CGRESULT_READ_ERROR;
+						goto finish;
+					}
+					src = buffer;
+				}
+			}
+			
+			StatSpan extractSpan(CG_STAT_EXTRACT);
+			extractSpan.count(0, info.width);
+			if (masked) {
+				unpacker.kernel(unpacker, src, pixels, info.width);
+				src = pixels;
+			}
+			if (bytesPerPixel == 0) {
+				for (int x = 0; x < info.width; x++) {
+					unsigned int *sum = sums + 4*(x / factor);
+					unsigned int pixel = info.palette[paletteIndex(src, x, bitsPerIndex)];
+					sum[0] += 0xffU & pixel;
+					sum[1] += 0xffU & pixel >> 8;
+					sum[2] += 0xffU & pixel >> 16;
+				}
+			}
+			else {
+				for (int x = 0; x < info.width; x++, src += bytesPerPixel) {
+					unsigned int *sum = sums + 4*(x / factor);
+					sum[0] += src[0];
+					sum[1] += src[1];
+					sum[2] += src[2];
+					if (bytesPerPixel == 4) { sum[3] += src[3]; }
+				}
+			}
+		}
+		
+		for (int outX = 0; outX < outWidth; outX++) {
+			int blockCols = (info.width - outX*factor < factor) ? info.width - outX*factor : factor;
+			unsigned int n = blockRows * blockCols;
+			const unsigned int *sum = sums + 4*outX;
+			unsigned int bv = (sum[0] + n/2) / n;
+			unsigned int gv = (sum[1] + n/2) / n;
+			unsigned int rv = (sum[2] + n/2) / n;
+			unsigned int av = (bytesPerPixel == 4) ? (sum[3] + n/2) / n : 0xffU;
+			unsigned int pixel = av << 24 | rv << 16 | gv << 8 | bv;
+			// NOTE: The extractors increment the output buffer pointers as necessary.
+			rx(pixel, rp);
+			gx(pixel, gp);
+			bx(pixel, bp);
+			ax(pixel, ap);
+		}
+		
+		advanceChannels(layout.skip, rp, gp, bp, ap);
+	}
+	
+	width = outWidth;
+	height = outHeight;
+	result = CGRESULT_OK;
+	
+finish:
+	delete[] sums;
+	return result;
+}
+
+// NOTE: Reads the bitmap array of an image whose header has been read.
+int readBMPPixels(
+	ByteStream &stream, const BMPInfo &info, int dataFormat,
+	int &width, int &height, void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	// NOTE: The rows are stored in the requested order as they are read, without a flip pass.
+	bool reversed = info.topDown != ((flags & CG_FLAG_TOP_DOWN) != 0);
+	RowLayout layout;
+	rowLayout(dataFormat, info.width, info.height, rowStride, reversed, layout, result);
+	if (result != CGRESULT_OK)
+		return result;
+	
+	width = info.width;
+	height = info.height;
+	advanceChannels(layout.first, r, g, b, a);
+	
+	// Read pixel data.
+	RLEDecoder decoder;
+	decoder.reset(info);
+	PaletteTables tables;
+	if (info.bitsPerPixel <= 8 && buildPaletteTables(info, dataFormat, tables, result) != CGRESULT_OK)
+		return result;
+	
+	return readBMPRows(
+		stream, info, decoder, tables, dataFormat, info.height, r, g, b, a, layout.skip, result);
+}
+
+int readBMP(
+	ByteStream &stream, int dataFormat, int maxWidth, int maxHeight,
+	int &width, int &height, void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	BMPInfo info;
+	if (readBMPHeader(stream, maxWidth, maxHeight, info, result) != CGRESULT_OK)
+		return result;
+	
+	return readBMPPixels(
+		stream, info, dataFormat, width, height, r, g, b, a, rowStride, flags, result);
 }
 
 
 // Image File Write Access
 int write24bitPixels(
-	FILE *fptr, int width, int height, Packer3 packer,
-	const void *r, const void *g, const void *b,
+	ByteStream &stream, int width, int height, Packer3 packer,
+	const void *r, const void *g, const void *b, ptrdiff_t rowSkipBytes,
 	int &result)
 {
-	char *buffer = new char[PIXEL_BUFFER_SIZE];
+	ScratchBuffer scratch(PIXEL_BUFFER_SIZE);
+	char *buffer = scratch.data();
 	if (!buffer)
 		return result = CGRESULT_ALLOC_FAILED;
 	
-	unsigned int pixelBytesPerRow = 3 * width;
-	unsigned int padBytesPerRow = (pixelBytesPerRow % 4 == 0) ? 0 : 4 - pixelBytesPerRow % 4;
-	unsigned int bytesPerRow = pixelBytesPerRow + padBytesPerRow;
-	unsigned int totalBytes = bytesPerRow * height;
-	unsigned int totalBytesWritten = 0;
-	const void *rp = r, *gp = g, *bp = b;
+	unsigned long long pixelBytesPerRow = 3ULL * width;
+	unsigned int padBytesPerRow = (unsigned int)(bitmapRowBytes(24, width) - pixelBytesPerRow);
+	unsigned long long bytesPerRow = pixelBytesPerRow + padBytesPerRow;
+	unsigned long long totalBytes = bytesPerRow * height;
+	unsigned long long totalBytesWritten = 0;
+	const void *rp = r, *gp = g, *bp = b, *ap = 0;
 	
 	while (totalBytesWritten < totalBytes) {
-		unsigned int bytesRemaining = totalBytes - totalBytesWritten;
-		unsigned int maxBytesBuffered =
-			(PIXEL_BUFFER_SIZE-2 < bytesRemaining) ? PIXEL_BUFFER_SIZE-2 : bytesRemaining;
-		unsigned int rowIndex = totalBytesWritten / bytesPerRow;
-		unsigned int columnIndex = (totalBytesWritten % bytesPerRow) / 3;
+		unsigned long long bytesRemaining = totalBytes - totalBytesWritten;
+		unsigned int maxBytesBuffered = (unsigned int)
+			((PIXEL_BUFFER_SIZE-2 < bytesRemaining) ? PIXEL_BUFFER_SIZE-2 : bytesRemaining);
+		unsigned long long rowIndex = totalBytesWritten / bytesPerRow;
+		unsigned int columnIndex = (unsigned int)((totalBytesWritten % bytesPerRow) / 3);
 		int bytesBuffered = 0;
+		StatSpan packSpan(CG_STAT_PACK);
 		
 		while (bytesBuffered < maxBytesBuffered) {
+			unsigned int firstColumn = columnIndex;
 			while (columnIndex < width && bytesBuffered < maxBytesBuffered) {
 				// NOTE: The packer increments the input buffer pointers as necessary.
 				unsigned int pixel = packer(rp, gp, bp);
 				std::memcpy(buffer + bytesBuffered, &pixel, 3);
 				columnIndex++;
 				bytesBuffered += 3;
+				
+				if (columnIndex == width)
+					advanceChannels(rowSkipBytes, rp, gp, bp, ap);
 			}
+			packSpan.count(0, columnIndex - firstColumn);
 			
 			if (padBytesPerRow > 0 && bytesBuffered < maxBytesBuffered) {
 				std::memset(buffer + bytesBuffered, 0, padBytesPerRow);
@@ -715,7 +2300,12 @@ int write24bitPixels(
 			columnIndex = 0;
 		}
 		
-		int bytesWritten = std::fwrite(buffer, 1, bytesBuffered, fptr);
+		packSpan.stop();
+		
+		StatSpan writeSpan(CG_STAT_WRITE_BITMAP);
+		int bytesWritten = stream.write(buffer, 1, bytesBuffered);
+		writeSpan.count(bytesWritten, 0);
+		writeSpan.stop();
 		if (bytesWritten != bytesBuffered) {
 			result = CGRESULT_WRITE_ERROR;
 			goto finish;
@@ -726,47 +2316,58 @@ int write24bitPixels(
 	result = CGRESULT_OK;
 	
 finish:
-	delete[] buffer;
 	return result;
 }
 
 int write32bitPixels(
-	FILE *fptr, int width, int height, Packer4 packer,
-	const void *r, const void *g, const void *b, const void *a,
+	ByteStream &stream, int width, int height, Packer4 packer,
+	const void *r, const void *g, const void *b, const void *a, ptrdiff_t rowSkipBytes,
 	int &result)
 {
-	char *buffer = new char[PIXEL_BUFFER_SIZE];
+	ScratchBuffer scratch(PIXEL_BUFFER_SIZE);
+	char *buffer = scratch.data();
 	if (!buffer)
 		return result = CGRESULT_ALLOC_FAILED;
 	
-	unsigned int pixelBytesPerRow = 4 * width;
-	unsigned int bytesPerRow = pixelBytesPerRow;
-	unsigned int totalBytes = bytesPerRow * height;
-	unsigned int totalBytesWritten = 0;
+	unsigned long long pixelBytesPerRow = 4ULL * width;
+	unsigned long long bytesPerRow = pixelBytesPerRow;
+	unsigned long long totalBytes = bytesPerRow * height;
+	unsigned long long totalBytesWritten = 0;
 	const void *rp = r, *gp = g, *bp = b, *ap = a;
 	
 	while (totalBytesWritten < totalBytes) {
-		unsigned int bytesRemaining = totalBytes - totalBytesWritten;
-		unsigned int maxBytesBuffered =
-			(PIXEL_BUFFER_SIZE-3 < bytesRemaining) ? PIXEL_BUFFER_SIZE-3 : bytesRemaining;
-		unsigned int rowIndex = totalBytesWritten / bytesPerRow;
-		unsigned int columnIndex = (totalBytesWritten % bytesPerRow) / 4;
+		unsigned long long bytesRemaining = totalBytes - totalBytesWritten;
+		unsigned int maxBytesBuffered = (unsigned int)
+			((PIXEL_BUFFER_SIZE-3 < bytesRemaining) ? PIXEL_BUFFER_SIZE-3 : bytesRemaining);
+		unsigned long long rowIndex = totalBytesWritten / bytesPerRow;
+		unsigned int columnIndex = (unsigned int)((totalBytesWritten % bytesPerRow) / 4);
 		int bytesBuffered = 0;
+		StatSpan packSpan(CG_STAT_PACK);
 		
 		while (bytesBuffered < maxBytesBuffered) {
+			unsigned int firstColumn = columnIndex;
 			while (columnIndex < width && bytesBuffered < maxBytesBuffered) {
 				// NOTE: The packer increments the input buffer pointers as necessary.
 				unsigned int pixel = packer(rp, gp, bp, ap);
 				std::memcpy(buffer + bytesBuffered, &pixel, 4);
 				columnIndex++;
 				bytesBuffered += 4;
+				
+				if (columnIndex == width)
+					advanceChannels(rowSkipBytes, rp, gp, bp, ap);
 			}
+			packSpan.count(0, columnIndex - firstColumn);
 			
 			rowIndex++;
 			columnIndex = 0;
 		}
 		
-		int bytesWritten = std::fwrite(buffer, 1, bytesBuffered, fptr);
+		packSpan.stop();
+		
+		StatSpan writeSpan(CG_STAT_WRITE_BITMAP);
+		int bytesWritten = stream.write(buffer, 1, bytesBuffered);
+		writeSpan.count(bytesWritten, 0);
+		writeSpan.stop();
 		if (bytesWritten != bytesBuffered) {
 			result = CGRESULT_WRITE_ERROR;
 			goto finish;
@@ -777,105 +2378,128 @@ int write32bitPixels(
 	result = CGRESULT_OK;
 	
 finish:
-	delete[] buffer;
 	return result;
 }
 
-// TODO: Enforce upper limits on width and height. The number of bytes in the bitmap
-// must fit in an unsigned 32-bit integer.
-int writeBMP(
-	FILE *fptr, int dataFormat, int width, int height,
-	const void *r, const void *g, const void *b, const void *a,
+// NOTE: The size fields of the headers are 32 bits wide, so the whole file must be smaller
+// than 4 GiB. The size of a compressed bitmap must be given, since it cannot be computed from
+// the dimensions. The palette entries are stored like the pixels of a 32-bit bitmap, and
+// written without their alpha.
+int writeBMPHeader(
+	ByteStream &stream, int width, int height, unsigned int bitsPerPixel,
+	unsigned int compression, unsigned long long compressedSize,
+	const unsigned int *palette, unsigned int paletteSize,
 	int &result)
 {
-	int bytesPerPixel = (a) ? 4 : 3;
-	unsigned int pixelBytesPerRow = bytesPerPixel * width;
-	unsigned int padBytesPerRow = (pixelBytesPerRow % 4 == 0) ? 0 : 4 - pixelBytesPerRow % 4;
-	unsigned int bitmapSize = (pixelBytesPerRow + padBytesPerRow) * height;
+	StatSpan span(CG_STAT_WRITE_HEADER);
+	unsigned int headerBytes = 54 + 4 * paletteSize;
+	span.count(headerBytes, 0);
+	if (width <= 0 || height <= 0)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	unsigned long long rowBytes = bitmapRowBytes(bitsPerPixel, width);
+	if (compression == BMP_COMPRESSION_NONE && rowBytes > (MAX_BMP_FILE_SIZE - headerBytes) / height)
+		return result = CGRESULT_BAD_DIMENSION;
+	if (compression != BMP_COMPRESSION_NONE && compressedSize > MAX_BMP_FILE_SIZE - headerBytes)
+		return result = CGRESULT_BAD_DIMENSION;
+	unsigned int bitmapSize =
+		(unsigned int)((compression == BMP_COMPRESSION_NONE) ? rowBytes * height : compressedSize);
 	
 	int fieldsWritten;
 	unsigned int tmp;
 	signed int stmp;
 	
 	// Write the file header.
-	fieldsWritten = std::fwrite("BM", 2, 1, fptr); // 0: Write "BM".
+	fieldsWritten = stream.write("BM", 2, 1); // 0: Write "BM".
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	tmp = 54 + bitmapSize;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 2: Write file size.
+	tmp = headerBytes + bitmapSize;
+	fieldsWritten = stream.write(&tmp, 4, 1); // 2: Write file size.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
 	tmp = 0;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 6: Write zeroed reserved fields.
+	fieldsWritten = stream.write(&tmp, 4, 1); // 6: Write zeroed reserved fields.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	tmp = 54;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 10: Write file offset to bitmap array.
+	tmp = headerBytes;
+	fieldsWritten = stream.write(&tmp, 4, 1); // 10: Write file offset to bitmap array.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
 	// Write the DIB header (BITMAPINFOHEADER).
 	tmp = 40;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 14: Write DIB header size.
+	fieldsWritten = stream.write(&tmp, 4, 1); // 14: Write DIB header size.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	fieldsWritten = std::fwrite(&width, 4, 1, fptr); // 18: Write image width.
+	fieldsWritten = stream.write(&width, 4, 1); // 18: Write image width.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	fieldsWritten = std::fwrite(&height, 4, 1, fptr); // 22: Write image height.
+	fieldsWritten = stream.write(&height, 4, 1); // 22: Write image height.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
 	tmp = 1;
-	fieldsWritten = std::fwrite(&tmp, 2, 1, fptr); // 26: Write "number of color planes".
+	fieldsWritten = stream.write(&tmp, 2, 1); // 26: Write "number of color planes".
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	tmp = 8 * bytesPerPixel;
-	fieldsWritten = std::fwrite(&tmp, 2, 1, fptr); // 28: Write bits per pixel.
+	tmp = bitsPerPixel;
+	fieldsWritten = stream.write(&tmp, 2, 1); // 28: Write bits per pixel.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	tmp = 0; // BI_RGB
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 30: Write compression method (i.e. none).
+	tmp = compression;
+	fieldsWritten = stream.write(&tmp, 4, 1); // 30: Write compression method.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	fieldsWritten = std::fwrite(&bitmapSize, 4, 1, fptr); // 34: Write bitmap size.
+	fieldsWritten = stream.write(&bitmapSize, 4, 1); // 34: Write bitmap size.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
 	tmp = 4000;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 38: Write horizontal resolution (pixels/m).
+	fieldsWritten = stream.write(&tmp, 4, 1); // 38: Write horizontal resolution (pixels/m).
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
 	tmp = 4000;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 42: Write vertical resolution (pixels/m).
+	fieldsWritten = stream.write(&tmp, 4, 1); // 42: Write vertical resolution (pixels/m).
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
-	tmp = 0;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 46: Write palette size (no palette).
+	tmp = paletteSize;
+	fieldsWritten = stream.write(&tmp, 4, 1); // 46: Write palette size.
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
 	tmp = 0;
-	fieldsWritten = std::fwrite(&tmp, 4, 1, fptr); // 50: Write "number of important colors".
+	fieldsWritten = stream.write(&tmp, 4, 1); // 50: Write "number of important colors".
 	if (fieldsWritten != 1)
 		return result = CGRESULT_WRITE_ERROR;
 	
 	// 54: End of Headers.
 	
-	// Write pixel data.
-	Packer3 p3;
-	Packer4 p4;
+	for (unsigned int i = 0; i < paletteSize; i++) {
+		tmp = 0xffffffU & palette[i];
+		fieldsWritten = stream.write(&tmp, 4, 1); // 54: Write palette.
+		if (fieldsWritten != 1)
+			return result = CGRESULT_WRITE_ERROR;
+	}
 	
+	return result = CGRESULT_OK;
+}
+
+int writeBMPHeader(ByteStream &stream, int width, int height, int bytesPerPixel, int &result) {
+	return writeBMPHeader(
+		stream, width, height, 8 * bytesPerPixel, BMP_COMPRESSION_NONE, 0, 0, 0, result);
+}
+
+int selectPackers(int dataFormat, Packer3 &p3, Packer4 &p4, int &result) {
 	switch (dataFormat) {
 	case CG_DATA_FORMAT_RGB:
 		p3 = packRGB;
@@ -897,12 +2521,26 @@ int writeBMP(
 		return result = CGRESULT_INVALID_ARGUMENT;
 	}
 	
+	return result = CGRESULT_OK;
+}
+
+// NOTE: Writes the next rowCount rows of the bitmap array, starting at the current file position.
+int writeBMPRows(
+	ByteStream &stream, int dataFormat, int width, int bytesPerPixel, int rowCount,
+	const void *r, const void *g, const void *b, const void *a, ptrdiff_t rowSkipBytes,
+	int &result)
+{
+	Packer3 p3;
+	Packer4 p4;
+	if (selectPackers(dataFormat, p3, p4, result) != CGRESULT_OK)
+		return result;
+	
 	switch (bytesPerPixel) {
 	case 3:
-		write24bitPixels(fptr, width, height, p3, r, g, b, result);
+		write24bitPixels(stream, width, rowCount, p3, r, g, b, rowSkipBytes, result);
 		break;
 	case 4:
-		write32bitPixels(fptr, width, height, p4, r, g, b, a, result);
+		write32bitPixels(stream, width, rowCount, p4, r, g, b, a, rowSkipBytes, result);
 		break;
 	default:
 		return result = CGRESULT_UNSPECIFIED;
@@ -911,230 +2549,2148 @@ int writeBMP(
 	return result;
 }
 
-int readImage(
-	const std::string &path, const std::string &type, int dataFormat, int maxWidth, int maxHeight,
-	int &width, int &height, void *r, void *g, void *b, void *a,
+int writeQuantizedBMP(
+	ByteStream &stream, int dataFormat, int width, int height,
+	const void *r, const void *g, const void *b, int rowStride, int flags,
+	int &result);
+
+int writeBMP(
+	ByteStream &stream, int dataFormat, int width, int height,
+	const void *r, const void *g, const void *b, const void *a, int rowStride, int flags,
 	int &result)
 {
-	int imageFormat = getImageFormat(path, type);
-	if (imageFormat == CG_FILE_FORMAT_NONE)
-		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	if (flags & CG_FLAG_INDEXED)
+		return writeQuantizedBMP(stream, dataFormat, width, height, r, g, b, rowStride, flags, result);
 	
-	// Open the source file.
-	FILE *fptr = std::fopen(path.c_str(), "rb");
-	if (!fptr)
-		return result = CGRESULT_FOPEN_FAILED;
+	int bytesPerPixel = (a) ? 4 : 3;
 	
-	// Read the source file.
-	result = CGRESULT_OK;
+	// NOTE: Check the data format before anything is written.
+	Packer3 p3;
+	Packer4 p4;
+	if (selectPackers(dataFormat, p3, p4, result) != CGRESULT_OK)
+		return result;
 	
-	switch (imageFormat) {
-	case CG_FILE_FORMAT_BMP:
-		readBMP(fptr, dataFormat, maxWidth, maxHeight, width, height, r, g, b, a, result);
-		break;
-	default:
-		result = CGRESULT_UNSPECIFIED;
-	}
+	// NOTE: The bitmap is always written bottom-to-top, so top-down channel buffers are
+	// visited from the last row up.
+	RowLayout layout;
+	bool reversed = (flags & CG_FLAG_TOP_DOWN) != 0;
+	if (rowLayout(dataFormat, width, height, rowStride, reversed, layout, result) != CGRESULT_OK)
+		return result;
 	
-	// Close the source file.
-	int closeResult = std::fclose(fptr);
-	if (closeResult)
-		result = CGRESULT_FCLOSE_FAILED;
+	if (writeBMPHeader(stream, width, height, bytesPerPixel, result) != CGRESULT_OK)
+		return result;
 	
-	return result;
+	// Write pixel data.
+	advanceChannels(layout.first, r, g, b, a);
+	return writeBMPRows(
+		stream, dataFormat, width, bytesPerPixel, height, r, g, b, a, layout.skip, result);
 }
 
-int writeImage(
-	const std::string &path, const std::string &type, int dataFormat, int width, int height,
-	const void *r, const void *g, const void *b, const void *a,
-	int &result)
-{
-	int imageFormat = getImageFormat(path, type);
-	if (imageFormat == CG_FILE_FORMAT_NONE)
-		return result = CGRESULT_UNSUPPORTED_FORMAT;
+void packIndexRow(const uchar *row, int width, unsigned int bitsPerPixel, uchar *out) {
+	std::memset(out, 0, (size_t)bitmapRowBytes(bitsPerPixel, width));
+	for (int x = 0; x < width; x++) {
+		size_t bit = (size_t)x * bitsPerPixel;
+		out[bit >> 3] |= row[x] << (8 - bitsPerPixel - (bit & 7));
+	}
+}
+
+// NOTE: Runs of three or more equal indices are encoded as runs, and the indices between them
+// in absolute mode, or as runs of one if there are fewer than three of them, which absolute
+// mode cannot hold. The row ends with an end of line, or an end of bitmap after the last row.
+// The encoded row takes at most 2*width + 2 bytes.
+size_t encodeRLE8Row(const uchar *row, int width, bool last, uchar *out) {
+	uchar *p = out;
+	int x = 0;
 	
-	// Open the destination file.
-	FILE *fptr = std::fopen(path.c_str(), "wb");
-	if (!fptr)
-		return result = CGRESULT_FOPEN_FAILED;
+	while (x < width) {
+		int run = 1;
+		while (x + run < width && run < 255 && row[x + run] == row[x])
+			run++;
+		
+		if (run >= 3) {
+			*p++ = (uchar)run;
+			*p++ = row[x];
+			x += run;
+			continue;
+		}
+		
+		int end = x + 1;
+		while (end < width && end - x < 255 &&
+			!(end + 2 < width && row[end] == row[end+1] && row[end] == row[end+2]))
+			end++;
+		
+		int count = end - x;
+		if (count < 3) {
+			for (; x < end; x++) {
+				*p++ = 1;
+				*p++ = row[x];
+			}
+		}
+		else {
+			*p++ = 0;
+			*p++ = (uchar)count;
+			std::memcpy(p, row + x, count);
+			p += count;
+			if (count & 1) { *p++ = 0; }
+			x = end;
+		}
+	}
+	
+	*p++ = 0;
+	*p++ = (last) ? 1 : 0;
+	return p - out;
+}
+
+// NOTE: The bitmap is written with the fewest bits per pixel that hold the palette, or with
+// BI_RLE8. The indices are checked, and an RLE bitmap is encoded once to measure it, before
+// anything is written, since the header holds its size.
+int writeIndexedBMP(
+	ByteStream &stream, int width, int height, const uchar *indices, int rowStride, int flags,
+	const unsigned int *palette, int paletteSize,
+	int &result)
+{
+	if (paletteSize <= 0 || paletteSize > 256)
+		return result = CGRESULT_INVALID_ARGUMENT;
+	if (width <= 0 || height <= 0)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	// NOTE: The indices are laid out like a byte channel.
+	RowLayout layout;
+	bool reversed = (flags & CG_FLAG_TOP_DOWN) != 0;
+	if (rowLayout(
+		CG_DATA_FORMAT_RGB_BYTES, width, height, rowStride, reversed, layout, result) != CGRESULT_OK)
+		return result;
+	const uchar *first = indices + layout.first;
+	ptrdiff_t rowStep = width + layout.skip;
+	
+	bool rle = (flags & CG_FLAG_RLE) != 0;
+	unsigned int compression = (rle) ? BMP_COMPRESSION_RLE8 : BMP_COMPRESSION_NONE;
+	unsigned int bitsPerPixel = (rle || paletteSize > 16) ? 8 : (paletteSize > 2) ? 4 : 1;
+	
+	ScratchBuffer scratch(2 * (size_t)width + 2);
+	uchar *buffer = (uchar *)scratch.data();
+	if (!buffer)
+		return result = CGRESULT_ALLOC_FAILED;
+	
+	unsigned long long compressedSize = 0;
+	const uchar *row = first;
+	for (int y = 0; y < height; y++, row += rowStep) {
+		for (int x = 0; x < width; x++) {
+			if (row[x] >= paletteSize)
+				return result = CGRESULT_INVALID_ARGUMENT;
+		}
+		if (rle)
+			compressedSize += encodeRLE8Row(row, width, y == height - 1, buffer);
+	}
+	
+	if (writeBMPHeader(
+		stream, width, height, bitsPerPixel, compression, compressedSize, palette, paletteSize,
+		result) != CGRESULT_OK)
+		return result;
+	
+	size_t bytesPerRow = (size_t)bitmapRowBytes(bitsPerPixel, width);
+	row = first;
+	for (int y = 0; y < height; y++, row += rowStep) {
+		StatSpan packSpan(CG_STAT_PACK);
+		packSpan.count(0, width);
+		size_t bytes = bytesPerRow;
+		if (rle)
+			bytes = encodeRLE8Row(row, width, y == height - 1, buffer);
+		else
+			packIndexRow(row, width, bitsPerPixel, buffer);
+		packSpan.stop();
+		
+		StatSpan writeSpan(CG_STAT_WRITE_BITMAP);
+		writeSpan.count(bytes, 0);
+		if (stream.write(buffer, 1, bytes) != bytes)
+			return result = CGRESULT_WRITE_ERROR;
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+
+// Color Quantization
+// NOTE: The palette is built by median cut from a histogram of a sample of the pixels, with the
+// colors reduced to 5-6-5 bits. The pixels are then mapped through an inverse lookup grid that
+// holds the nearest palette entry of every 5-6-5 color, so that mapping a pixel is a single
+// lookup. The grid is filled once per image, and the rows are mapped in parallel.
+const int QUANTIZE_SAMPLES = 256 * 1024;
+const int QUANTIZE_GRID_SIZE = 65536;
+
+inline unsigned int colorKey565(unsigned int pixel) {
+	return (pixel >> 8 & 0xf800U) | (pixel >> 5 & 0x07e0U) | (pixel >> 3 & 0x001fU);
+}
+
+inline unsigned int keyComponent(unsigned int key, int axis) {
+	return (axis == 0) ? key >> 11 : (axis == 1) ? key >> 5 & 0x3fU : key & 0x1fU;
+}
+
+struct ColorBin {
+	unsigned int count;
+	unsigned int sums[3]; // Red, green and blue.
+};
+
+// NOTE: A box holds the range [begin, end) of the occupied bins, and is split along the axis
+// with the largest extent, measured in 8-bit units.
+struct ColorBox {
+	int begin;
+	int end;
+	unsigned int count;
+	int axis;
+	unsigned int extent;
+};
+
+struct Quantizer {
+	ColorBin bins[QUANTIZE_GRID_SIZE];
+	unsigned short keys[QUANTIZE_GRID_SIZE];
+	uchar grid[QUANTIZE_GRID_SIZE];
+};
+
+struct KeyAxisLess {
+	explicit KeyAxisLess(int axis) : axis(axis) {}
+	bool operator()(unsigned short k1, unsigned short k2) const {
+		return keyComponent(k1, axis) < keyComponent(k2, axis);
+	}
+	int axis;
+};
+
+void measureColorBox(const Quantizer &quantizer, ColorBox &box) {
+	unsigned int low[3] = { 0xffU, 0xffU, 0xffU }, high[3] = { 0, 0, 0 };
+	box.count = 0;
+	for (int i = box.begin; i < box.end; i++) {
+		unsigned int key = quantizer.keys[i];
+		box.count += quantizer.bins[key].count;
+		for (int c = 0; c < 3; c++) {
+			unsigned int v = keyComponent(key, c);
+			if (v < low[c])  { low[c] = v; }
+			if (v > high[c]) { high[c] = v; }
+		}
+	}
+	
+	box.axis = 0;
+	box.extent = 0;
+	for (int c = 0; c < 3; c++) {
+		unsigned int extent = (high[c] - low[c]) << ((c == 1) ? 2 : 3);
+		if (extent > box.extent) {
+			box.axis = c;
+			box.extent = extent;
+		}
+	}
+}
+
+// NOTE: The box with the largest product of pixel count and extent is split at the median of
+// its pixels, until there are maxColors boxes or no box holds more than one bin.
+int buildQuantizedPalette(Quantizer &quantizer, int maxColors, unsigned int *palette) {
+	int keyCount = 0;
+	for (int key = 0; key < QUANTIZE_GRID_SIZE; key++) {
+		if (quantizer.bins[key].count)
+			quantizer.keys[keyCount++] = (unsigned short)key;
+	}
+	if (keyCount == 0)
+		return 0;
+	
+	ColorBox boxes[256];
+	int boxCount = 1;
+	boxes[0].begin = 0;
+	boxes[0].end = keyCount;
+	measureColorBox(quantizer, boxes[0]);
+	
+	while (boxCount < maxColors) {
+		int best = -1;
+		unsigned long long bestScore = 0;
+		for (int i = 0; i < boxCount; i++) {
+			unsigned long long score = (unsigned long long)boxes[i].count * boxes[i].extent;
+			if (boxes[i].end - boxes[i].begin > 1 && score > bestScore) {
+				best = i;
+				bestScore = score;
+			}
+		}
+		if (best < 0)
+			break;
+		
+		ColorBox &box = boxes[best];
+		unsigned short *first = quantizer.keys + box.begin, *last = quantizer.keys + box.end;
+		std::sort(first, last, KeyAxisLess(box.axis));
+		
+		int split = box.end - 1;
+		unsigned long long total = 0;
+		for (int i = box.begin; i < box.end - 1; i++) {
+			total += quantizer.bins[quantizer.keys[i]].count;
+			if (2 * total >= box.count) {
+				split = i + 1;
+				break;
+			}
+		}
+		
+		ColorBox &upper = boxes[boxCount++];
+		upper.begin = split;
+		upper.end = box.end;
+		box.end = split;
+		measureColorBox(quantizer, box);
+		measureColorBox(quantizer, upper);
+	}
+	
+	for (int i = 0; i < boxCount; i++) {
+		unsigned long long sums[3] = { 0, 0, 0 };
+		for (int k = boxes[i].begin; k < boxes[i].end; k++) {
+			const ColorBin &bin = quantizer.bins[quantizer.keys[k]];
+			for (int c = 0; c < 3; c++)
+				sums[c] += bin.sums[c];
+		}
+		
+		unsigned long long n = boxes[i].count;
+		unsigned int rv = (unsigned int)((sums[0] + n/2) / n);
+		unsigned int gv = (unsigned int)((sums[1] + n/2) / n);
+		unsigned int bv = (unsigned int)((sums[2] + n/2) / n);
+		palette[i] = rv << 16 | gv << 8 | bv;
+	}
+	
+	return boxCount;
+}
+
+struct PaletteGreenLess {
+	explicit PaletteGreenLess(const unsigned int *palette) : palette(palette) {}
+	bool operator()(int i1, int i2) const {
+		return (palette[i1] >> 8 & 0xffU) < (palette[i2] >> 8 & 0xffU);
+	}
+	const unsigned int *palette;
+};
+
+// NOTE: Each grid color is matched against the palette sorted by green, searching outward
+// from its green value until the green difference alone exceeds the best distance. Ties go
+// to the lower palette index.
+void fillInverseGrid(const unsigned int *palette, int paletteSize, uchar *grid) {
+	int order[256];
+	for (int i = 0; i < paletteSize; i++)
+		order[i] = i;
+	std::sort(order, order + paletteSize, PaletteGreenLess(palette));
+	
+	int start[64];
+	for (int g6 = 0, i = 0; g6 < 64; g6++) {
+		unsigned int gv = g6 << 2 | g6 >> 4;
+		while (i < paletteSize && (palette[order[i]] >> 8 & 0xffU) < gv)
+			i++;
+		start[g6] = i;
+	}
+	
+	#pragma omp parallel for num_threads(contextThreads())
+	for (int key = 0; key < QUANTIZE_GRID_SIZE; key++) {
+		unsigned int r5 = key >> 11, g6 = key >> 5 & 0x3fU, b5 = key & 0x1fU;
+		int rv = r5 << 3 | r5 >> 2, gv = g6 << 2 | g6 >> 4, bv = b5 << 3 | b5 >> 2;
+		int bestIndex = 0, bestDistance = 0x7fffffff;
+		
+		for (int pass = 0; pass < 2; pass++) {
+			int step = (pass == 0) ? 1 : -1;
+			int first = (pass == 0) ? start[g6] : start[g6] - 1;
+			for (int i = first; i >= 0 && i < paletteSize; i += step) {
+				unsigned int color = palette[order[i]];
+				int dg = (int)(color >> 8 & 0xffU) - gv;
+				if (dg*dg > bestDistance)
+					break;
+				
+				int dr = (int)(color >> 16 & 0xffU) - rv, db = (int)(color & 0xffU) - bv;
+				int distance = dr*dr + dg*dg + db*db;
+				if (distance < bestDistance || (distance == bestDistance && order[i] < bestIndex)) {
+					bestIndex = order[i];
+					bestDistance = distance;
+				}
+			}
+		}
+		
+		grid[key] = (uchar)bestIndex;
+	}
+}
+
+// NOTE: Quantizes the channels to at most 256 colors, and stores the indices bottom-to-top
+// and tightly packed. The sample is a regular grid of pixels, with the same step in x and y.
+int quantizeImage(
+	int dataFormat, int width, int height,
+	const void *r, const void *g, const void *b, int rowStride, int flags,
+	uchar *indices, unsigned int *palette, int &paletteSize,
+	int &result)
+{
+	Packer3 p3;
+	Packer4 p4;
+	if (selectPackers(dataFormat, p3, p4, result) != CGRESULT_OK)
+		return result;
+	
+	RowLayout layout;
+	bool reversed = (flags & CG_FLAG_TOP_DOWN) != 0;
+	if (rowLayout(dataFormat, width, height, rowStride, reversed, layout, result) != CGRESULT_OK)
+		return result;
+	
+	StatSpan span(CG_STAT_CONVERT);
+	span.count(0, (long long)width * height);
+	
+	Quantizer *quantizer = new Quantizer;
+	if (!quantizer)
+		return result = CGRESULT_ALLOC_FAILED;
+	std::memset(quantizer->bins, 0, sizeof(quantizer->bins));
+	
+	ptrdiff_t pixelBytes = (ptrdiff_t)channelSize(dataFormat);
+	ptrdiff_t rowBytes = pixelBytes * width + layout.skip;
+	double ratio = (double)width * height / QUANTIZE_SAMPLES;
+	int step = (ratio > 1.0) ? (int)std::ceil(std::sqrt(ratio)) : 1;
+	
+	for (int y = (step / 2 < height) ? step / 2 : 0; y < height; y += step) {
+		for (int x = (step / 2 < width) ? step / 2 : 0; x < width; x += step) {
+			const void *rp = r, *gp = g, *bp = b, *ap = 0;
+			advanceChannels(layout.first + rowBytes * y + pixelBytes * x, rp, gp, bp, ap);
+			unsigned int pixel = p3(rp, gp, bp);
+			ColorBin &bin = quantizer->bins[colorKey565(pixel)];
+			bin.count++;
+			bin.sums[0] += pixel >> 16 & 0xffU;
+			bin.sums[1] += pixel >> 8 & 0xffU;
+			bin.sums[2] += pixel & 0xffU;
+		}
+	}
+	
+	paletteSize = buildQuantizedPalette(*quantizer, 256, palette);
+	fillInverseGrid(palette, paletteSize, quantizer->grid);
+	const uchar *grid = quantizer->grid;
+	
+	#pragma omp parallel for num_threads(contextThreads())
+	for (int y = 0; y < height; y++) {
+		const void *rp = r, *gp = g, *bp = b, *ap = 0;
+		advanceChannels(layout.first + rowBytes * y, rp, gp, bp, ap);
+		uchar *out = indices + (size_t)width * y;
+		for (int x = 0; x < width; x++)
+			out[x] = grid[colorKey565(p3(rp, gp, bp))];
+	}
+	
+	delete quantizer;
+	return result = CGRESULT_OK;
+}
+
+// NOTE: The alpha channel is not written, since indexed-color bitmaps are opaque.
+int writeQuantizedBMP(
+	ByteStream &stream, int dataFormat, int width, int height,
+	const void *r, const void *g, const void *b, int rowStride, int flags,
+	int &result)
+{
+	if (width <= 0 || height <= 0)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	uchar *indices = new uchar[(size_t)width * height];
+	if (!indices)
+		return result = CGRESULT_ALLOC_FAILED;
+	
+	unsigned int palette[256];
+	int paletteSize = 0;
+	if (quantizeImage(
+		dataFormat, width, height, r, g, b, rowStride, flags, indices, palette, paletteSize,
+		result) == CGRESULT_OK)
+	{
+		writeIndexedBMP(
+			stream, width, height, indices, 0, flags & CG_FLAG_RLE, palette, paletteSize, result);
+	}
+	
+	delete[] indices;
+	return result;
+}
+
+// Image Comparison
+// NOTE: Bitmaps stored in the same way are compared directly, a band of tileHeight rows at a
+// time. Since both arrays must be read in full anyway, a byte comparison is cheaper than
+// hashing them. Only the pixel bytes of each row are compared, not its padding.
+
+// Marks the tiles of tileRow whose bytes differ between the rows, bytesPerTile bytes a tile.
+void markChangedTiles(
+	const char *row1, const char *row2, size_t rowBytes, size_t bytesPerTile, int tilesX,
+	uchar *tileRow)
+{
+	for (int tx = 0; tx < tilesX; tx++) {
+		if (tileRow[tx])
+			continue;
+		
+		size_t offset = bytesPerTile * tx;
+		size_t length = (rowBytes - offset < bytesPerTile) ? rowBytes - offset : bytesPerTile;
+		
+		if (std::memcmp(row1 + offset, row2 + offset, length) != 0)
+			tileRow[tx] = 1;
+	}
+}
+
+int compareRawBands(
+	ByteStream &stream1, ByteStream &stream2, const BMPInfo &info, int tileWidth, int tileHeight,
+	int tilesX, int tilesY, int &equal, uchar *tileMap,
+	int &result)
+{
+	size_t pixelBytesPerRow = (size_t)info.bytesPerPixel * info.width;
+	size_t bytesPerRow = (size_t)bitmapRowBytes(info.bitsPerPixel, info.width);
+	size_t bytesPerTileRow = (size_t)info.bytesPerPixel * tileWidth;
+	
+	ScratchBuffer scratch1(bytesPerRow * tileHeight), scratch2(bytesPerRow * tileHeight);
+	char *band1 = scratch1.data(), *band2 = scratch2.data();
+	if (!band1 || !band2)
+		return result = CGRESULT_ALLOC_FAILED;
+	
+	equal = 1;
+	
+	for (int i = 0; i < tilesY; i++) {
+		int ty = (info.topDown) ? tilesY - 1 - i : i;
+		int rows = (info.height - ty*tileHeight < tileHeight) ?
+			info.height - ty*tileHeight : tileHeight;
+		size_t bandBytes = bytesPerRow * rows;
+		
+		StatSpan readSpan(CG_STAT_READ_BITMAP);
+		readSpan.count(2 * (long long)bandBytes, 0);
+		if (stream1.read(band1, 1, bandBytes) != bandBytes ||
+			stream2.read(band2, 1, bandBytes) != bandBytes)
+		{
+			return result = CGRESULT_READ_ERROR;
+		}
+		readSpan.stop();
+		
+		bool same = true;
+		for (int row = 0; row < rows && same; row++) {
+			size_t offset = bytesPerRow * row;
+			same = std::memcmp(band1 + offset, band2 + offset, pixelBytesPerRow) == 0;
+		}
+		if (same)
+			continue;
+		
+		equal = 0;
+		if (!tileMap)
+			break; // Early exit on the first difference.
+		
+		for (int row = 0; row < rows; row++) {
+			size_t offset = bytesPerRow * row;
+			markChangedTiles(
+				band1 + offset, band2 + offset, pixelBytesPerRow, bytesPerTileRow, tilesX,
+				tileMap + ty*tilesX);
+		}
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+// NOTE: Reads the rows [y, y + rows) of the image as RGBA byte planes of width * rows bytes
+// each, bottom-to-top. The rows of a top-down bitmap are read by seeking to each in turn.
+int readDecodedBand(
+	ByteStream &stream, const BMPInfo &info, RLEDecoder &decoder, const PaletteTables &tables,
+	long long bitmapOffset, int y, int rows, uchar *planes,
+	int &result)
+{
+	size_t planeBytes = (size_t)info.width * rows;
+	void *r = planes, *g = planes + planeBytes, *b = planes + 2*planeBytes, *a = planes + 3*planeBytes;
+	
+	if (!info.topDown) {
+		return readBMPRows(
+			stream, info, decoder, tables, CG_DATA_FORMAT_RGB_BYTES, rows, r, g, b, a, 0, result);
+	}
+	
+	unsigned long long bytesPerRow = bitmapRowBytes(info.bitsPerPixel, info.width);
+	
+	for (int row = 0; row < rows; row++) {
+		int fileRow = info.height - 1 - (y + row);
+		if (stream.seek(bitmapOffset + (long long)(bytesPerRow * fileRow), SEEK_SET))
+			return result = CGRESULT_SEEK_ERROR;
+		
+		if (readBMPRows(
+			stream, info, decoder, tables, CG_DATA_FORMAT_RGB_BYTES, 1, r, g, b, a, 0, result)
+			!= CGRESULT_OK)
+		{
+			return result;
+		}
+		advanceChannels(info.width, r, g, b, a);
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+// NOTE: Bitmaps that cannot be compared byte by byte are decoded to RGBA bytes a band at a
+// time, bottom-to-top, and the decoded bands are compared. This covers different row orders
+// and pixel formats, bit field bitmaps with different masks, and indexed-color bitmaps, whose
+// equal palette indices need not be equal colors.
+int compareDecodedBands(
+	ByteStream &stream1, ByteStream &stream2, const BMPInfo &info1, const BMPInfo &info2,
+	int tileWidth, int tileHeight, int tilesX, int tilesY, int &equal, uchar *tileMap,
+	int &result)
+{
+	const BMPInfo *infos[2] = { &info1, &info2 };
+	ByteStream *streams[2] = { &stream1, &stream2 };
+	RLEDecoder decoders[2];
+	PaletteTables tables[2];
+	long long bitmapOffsets[2];
+	
+	for (int k = 0; k < 2; k++) {
+		decoders[k].reset(*infos[k]);
+		bitmapOffsets[k] = streams[k]->tell();
+		if (bitmapOffsets[k] < 0)
+			return result = CGRESULT_SEEK_ERROR;
+		if (infos[k]->bitsPerPixel <= 8 &&
+			buildPaletteTables(*infos[k], CG_DATA_FORMAT_RGB_BYTES, tables[k], result) != CGRESULT_OK)
+		{
+			return result;
+		}
+	}
+	
+	int width = info1.width;
+	size_t bandBytes = 4 * (size_t)width * tileHeight;
+	ScratchBuffer scratch1(bandBytes), scratch2(bandBytes);
+	uchar *band1 = (uchar *)scratch1.data(), *band2 = (uchar *)scratch2.data();
+	if (!band1 || !band2)
+		return result = CGRESULT_ALLOC_FAILED;
+	
+	equal = 1;
+	
+	for (int ty = 0; ty < tilesY; ty++) {
+		int y = ty*tileHeight;
+		int rows = (info1.height - y < tileHeight) ? info1.height - y : tileHeight;
+		
+		if (readDecodedBand(
+			stream1, info1, decoders[0], tables[0], bitmapOffsets[0], y, rows, band1, result)
+			!= CGRESULT_OK ||
+			readDecodedBand(
+			stream2, info2, decoders[1], tables[1], bitmapOffsets[1], y, rows, band2, result)
+			!= CGRESULT_OK)
+		{
+			return result;
+		}
+		
+		size_t planeBytes = (size_t)width * rows;
+		if (std::memcmp(band1, band2, 4 * planeBytes) == 0)
+			continue;
+		
+		equal = 0;
+		if (!tileMap)
+			break; // Early exit on the first difference.
+		
+		for (int c = 0; c < 4; c++) {
+			for (int row = 0; row < rows; row++) {
+				size_t offset = planeBytes * c + (size_t)width * row;
+				markChangedTiles(
+					(const char *)band1 + offset, (const char *)band2 + offset, width, tileWidth,
+					tilesX, tileMap + ty*tilesX);
+			}
+		}
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+int compareBMPs(
+	ByteStream &stream1, ByteStream &stream2, int tileWidth, int tileHeight, int maxTiles,
+	int &equal, int &tilesX, int &tilesY, uchar *tileMap,
+	int &result)
+{
+	const int maxSize = 0x7fffffff;
+	BMPInfo info1, info2;
+	
+	if (readBMPHeader(stream1, maxSize, maxSize, info1, result) != CGRESULT_OK)
+		return result;
+	if (readBMPHeader(stream2, maxSize, maxSize, info2, result) != CGRESULT_OK)
+		return result;
+	
+	equal = 0;
+	tilesX = tilesY = 0;
+	
+	if (info1.width != info2.width || info1.height != info2.height)
+		return result = CGRESULT_OK; // No tiles to compare.
+	
+	tilesX = (info1.width + tileWidth - 1) / tileWidth;
+	tilesY = (info1.height + tileHeight - 1) / tileHeight;
+	
+	if (tileMap) {
+		if (tilesX * tilesY > maxTiles)
+			return result = CGRESULT_BAD_DIMENSION;
+		std::memset(tileMap, 0, tilesX * tilesY);
+	}
+	
+	bool raw = info1.topDown == info2.topDown &&
+		info1.bytesPerPixel != 0 && info1.bytesPerPixel == info2.bytesPerPixel &&
+		info1.compression == info2.compression &&
+		std::memcmp(info1.masks, info2.masks, sizeof(info1.masks)) == 0;
+	
+	if (raw) {
+		return compareRawBands(
+			stream1, stream2, info1, tileWidth, tileHeight, tilesX, tilesY, equal, tileMap,
+			result);
+	}
+	
+	return compareDecodedBands(
+		stream1, stream2, info1, info2, tileWidth, tileHeight, tilesX, tilesY, equal, tileMap,
+		result);
+}
+
+// Decode Cache
+// NOTE: Decoded images are cached with all four channels, bottom-to-top and tightly packed,
+// so that a hit can serve any subset of channels in any row layout by copying rows. A cached
+// image is identified by its path, file size, modification time and data format; since the
+// modification time may have a coarse resolution, images written by this library are also
+// dropped from the caches of all contexts. Each context has its own cache, guarded by its own
+// lock, since the default context is shared by threads and a write on any thread drops
+// images from every cache. Entries are held through shared pointers, so that a hit is copied
+// to the caller's buffers outside the lock while the entry may be evicted by another thread.
+struct CacheKey {
+	std::string path;
+	long long size;
+	long long mtime;
+	int dataFormat;
+	
+	bool operator<(const CacheKey &k) const {
+		if (path != k.path)             { return path < k.path; }
+		if (size != k.size)             { return size < k.size; }
+		if (mtime != k.mtime)           { return mtime < k.mtime; }
+		return dataFormat < k.dataFormat;
+	}
+};
+
+struct CacheEntry {
+	CacheKey key;
+	int width;
+	int height;
+	std::vector<char> planes;
+};
+
+typedef std::shared_ptr<const CacheEntry> CacheEntryPtr;
+typedef std::list<CacheEntryPtr> CacheList;
+
+} // end anonymous namespace
+
+struct DecodeCache {
+	DecodeCache() : maxBytes(0), bytes(0), hits(0), misses(0) {
+#ifdef _OPENMP
+		omp_init_lock(&lock);
+#endif
+	}
+	
+	~DecodeCache() {
+#ifdef _OPENMP
+		omp_destroy_lock(&lock);
+#endif
+	}
+	
+	size_t maxBytes;
+	size_t bytes;
+	long long hits;
+	long long misses;
+	CacheList entries; // Most recently used first.
+	std::map<CacheKey, CacheList::iterator> index;
+#ifdef _OPENMP
+	omp_lock_t lock;
+#endif
+};
+
+namespace { // begin anonymous namespace
+
+// NOTE: Holds the lock of a cache for the lifetime of the object.
+class CacheLock {
+public:
+	explicit CacheLock(DecodeCache &cache) : locked(cache) {
+#ifdef _OPENMP
+		omp_set_lock(&locked.lock);
+#endif
+	}
+	
+	~CacheLock() {
+#ifdef _OPENMP
+		omp_unset_lock(&locked.lock);
+#endif
+	}
+	
+private:
+	CacheLock(const CacheLock &);
+	CacheLock &operator=(const CacheLock &);
+	
+	DecodeCache &locked;
+};
+
+// NOTE: The caches of the contexts other than the default one are listed for the writes that
+// drop images from all of them. The list is guarded by the cgDecodeCache critical section.
+DecodeCache defaultDecodeCache;
+std::vector<DecodeCache *> contextDecodeCaches;
+
+// Gets the cache of the calling thread's context, or null if the bound context has none yet.
+DecodeCache *currentDecodeCache() {
+	cg_context *context = threadContext();
+	return (context) ? context->decodeCache : &defaultDecodeCache;
+}
+
+// NOTE: Must be called with the cache locked.
+void evictCachedImages(DecodeCache &cache, size_t maxBytes) {
+	while (cache.bytes > maxBytes) {
+		const CacheEntry &last = *cache.entries.back();
+		cache.bytes -= last.planes.size();
+		cache.index.erase(last.key);
+		cache.entries.pop_back();
+	}
+}
+
+// NOTE: Must be called with the cache locked.
+void dropCachedImages(DecodeCache &cache, const std::string &path) {
+	CacheList::iterator it = cache.entries.begin();
+	while (it != cache.entries.end()) {
+		if ((*it)->key.path == path) {
+			cache.bytes -= (*it)->planes.size();
+			cache.index.erase((*it)->key);
+			it = cache.entries.erase(it);
+		}
+		else {
+			it++;
+		}
+	}
+}
+
+void dropCachedImages(const std::string &path) {
+	#pragma omp critical(cgDecodeCache)
+	{
+		CacheLock lock(defaultDecodeCache);
+		dropCachedImages(defaultDecodeCache, path);
+		
+		for (size_t i = 0; i < contextDecodeCaches.size(); i++) {
+			CacheLock contextLock(*contextDecodeCaches[i]);
+			dropCachedImages(*contextDecodeCaches[i], path);
+		}
+	}
+}
+
+int copyCachedImage(
+	const CacheEntry &entry, void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	int width = entry.width, height = entry.height;
+	if (rowStride == 0)
+		rowStride = width;
+	else if (rowStride < width)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	size_t size = channelSize(entry.key.dataFormat);
+	size_t rowBytes = size * width;
+	size_t planeBytes = rowBytes * height;
+	bool topDown = (flags & CG_FLAG_TOP_DOWN) != 0;
+	void *channels[4] = { r, g, b, a };
+	
+	for (int c = 0; c < 4; c++) {
+		if (!channels[c])
+			continue;
+		
+		const char *src = &entry.planes[0] + planeBytes * c;
+		char *dst = (char *)channels[c];
+		
+		if (rowStride == width && !topDown) {
+			std::memcpy(dst, src, planeBytes);
+			continue;
+		}
+		
+		for (int y = 0; y < height; y++) {
+			int dstRow = (topDown) ? height - 1 - y : y;
+			std::memcpy(dst + size * rowStride * dstRow, src + rowBytes * y, rowBytes);
+		}
+	}
+	
+	return result = CGRESULT_OK;
+}
+
+int readImage(
+	const std::string &path, const std::string &type, int dataFormat, int maxWidth, int maxHeight,
+	int &width, int &height, void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	int imageFormat = getImageFormat(path, type);
+	if (imageFormat == CG_FILE_FORMAT_NONE)
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	
+	// Open the source file.
+	FILE *fptr = openFile(path.c_str(), "rb");
+	if (!fptr)
+		return result = CGRESULT_FOPEN_FAILED;
+	FileStream stream(fptr);
+	
+	// Read the source file.
+	result = CGRESULT_OK;
+	
+	switch (imageFormat) {
+	case CG_FILE_FORMAT_BMP:
+		readBMP(
+			stream, dataFormat, maxWidth, maxHeight, width, height, r, g, b, a, rowStride, flags,
+			result);
+		break;
+	default:
+		result = CGRESULT_UNSPECIFIED;
+	}
+	
+	// Close the source file.
+	int closeResult = closeFile(fptr);
+	if (closeResult)
+		result = CGRESULT_FCLOSE_FAILED;
+	
+	return result;
+}
+
+int readImageRegion(
+	const std::string &path, const std::string &type, int dataFormat,
+	int x, int y, int width, int height, void *r, void *g, void *b, void *a,
+	int rowStride, int flags,
+	int &result)
+{
+	int imageFormat = getImageFormat(path, type);
+	if (imageFormat == CG_FILE_FORMAT_NONE)
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	
+	// Open the source file.
+	FILE *fptr = openFile(path.c_str(), "rb");
+	if (!fptr)
+		return result = CGRESULT_FOPEN_FAILED;
+	FileStream stream(fptr);
+	
+	// Read the region from the source file.
+	result = CGRESULT_OK;
+	
+	switch (imageFormat) {
+	case CG_FILE_FORMAT_BMP:
+		readBMPRegion(stream, dataFormat, x, y, width, height, r, g, b, a, rowStride, flags, result);
+		break;
+	default:
+		result = CGRESULT_UNSPECIFIED;
+	}
+	
+	// Close the source file.
+	int closeResult = closeFile(fptr);
+	if (closeResult)
+		result = CGRESULT_FCLOSE_FAILED;
+	
+	return result;
+}
+
+int readImageDecimated(
+	const std::string &path, const std::string &type, int dataFormat, int factor,
+	int maxWidth, int maxHeight, int &width, int &height, void *r, void *g, void *b, void *a,
+	int &result)
+{
+	if (factor != 1 && factor != 2 && factor != 4 && factor != 8)
+		return result = CGRESULT_INVALID_ARGUMENT;
+	
+	int imageFormat = getImageFormat(path, type);
+	if (imageFormat == CG_FILE_FORMAT_NONE)
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	
+	// Open the source file.
+	FILE *fptr = openFile(path.c_str(), "rb");
+	if (!fptr)
+		return result = CGRESULT_FOPEN_FAILED;
+	FileStream stream(fptr);
+	
+	// Read the source file.
+	result = CGRESULT_OK;
+	
+	switch (imageFormat) {
+	case CG_FILE_FORMAT_BMP:
+		readBMPDecimated(
+			stream, dataFormat, factor, maxWidth, maxHeight, width, height, r, g, b, a, result);
+		break;
+	default:
+		result = CGRESULT_UNSPECIFIED;
+	}
+	
+	// Close the source file.
+	int closeResult = closeFile(fptr);
+	if (closeResult)
+		result = CGRESULT_FCLOSE_FAILED;
+	
+	return result;
+}
+
+int writeImage(
+	const std::string &path, const std::string &type, int dataFormat, int width, int height,
+	const void *r, const void *g, const void *b, const void *a, int rowStride, int flags,
+	int &result)
+{
+	int imageFormat = getImageFormat(path, type);
+	if (imageFormat == CG_FILE_FORMAT_NONE)
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	
+	dropCachedImages(path);
+	
+	// Open the destination file.
+	FILE *fptr = openFile(path.c_str(), "wb");
+	if (!fptr)
+		return result = CGRESULT_FOPEN_FAILED;
+	FileStream stream(fptr);
+	
+	// Write the destination file.
+	result = CGRESULT_OK;
+	
+	switch (imageFormat) {
+	case CG_FILE_FORMAT_BMP:
+		writeBMP(stream, dataFormat, width, height, r, g, b, a, rowStride, flags, result);
+		break;
+	default:
+		result = CGRESULT_UNSPECIFIED;
+	}
+	
+	// Close the destination file.
+	int closeResult = closeFile(fptr);
+	if (closeResult)
+		result = CGRESULT_FCLOSE_FAILED;
+	
+	return result;
+}
+
+// NOTE: A descriptor cannot be rewound to recognize the image format, so BMP, the only format
+// with a decoder, is assumed; the header check rejects anything else.
+int readImageFd(
+	int fd, int dataFormat, int maxWidth, int maxHeight,
+	int &width, int &height, void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	FdStream stream(fd);
+	BMPInfo info;
+	if (readBMPHeader(stream, maxWidth, maxHeight, info, result) != CGRESULT_OK)
+		return result;
+	if (readBMPPixels(
+		stream, info, dataFormat, width, height, r, g, b, a, rowStride, flags, result)
+		!= CGRESULT_OK)
+	{
+		return result;
+	}
+	
+	// NOTE: The rest of the image (such as an ICC profile after the bitmap array, or the last
+	// bytes of an RLE bitmap) is read and dropped, so that the next image on the descriptor
+	// starts at its position. A file that ends early is not an error, since the pixels have
+	// all been read.
+	if ((unsigned long long)stream.tell() < info.fileBytes)
+		stream.seek((long long)info.fileBytes, SEEK_SET);
+	
+	return result;
+}
+
+int writeIndexedImage(
+	const std::string &path, const std::string &type, int width, int height,
+	const uchar *indices, int rowStride, int flags, const unsigned int *palette, int paletteSize,
+	int &result)
+{
+	int imageFormat = getImageFormat(path, type);
+	if (imageFormat == CG_FILE_FORMAT_NONE)
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	
+	dropCachedImages(path);
+	
+	// Open the destination file.
+	FILE *fptr = openFile(path.c_str(), "wb");
+	if (!fptr)
+		return result = CGRESULT_FOPEN_FAILED;
+	FileStream stream(fptr);
 	
 	// Write the destination file.
 	result = CGRESULT_OK;
 	
 	switch (imageFormat) {
 	case CG_FILE_FORMAT_BMP:
-		writeBMP(fptr, dataFormat, width, height, r, g, b, a, result);
+		writeIndexedBMP(
+			stream, width, height, indices, rowStride, flags, palette, paletteSize, result);
 		break;
 	default:
 		result = CGRESULT_UNSPECIFIED;
 	}
 	
 	// Close the destination file.
-	int closeResult = std::fclose(fptr);
+	int closeResult = closeFile(fptr);
 	if (closeResult)
 		result = CGRESULT_FCLOSE_FAILED;
 	
 	return result;
 }
 
-} // end anonymous namespace
+int writeImageFd(
+	int fd, const std::string &type, int dataFormat, int width, int height,
+	const void *r, const void *g, const void *b, const void *a, int rowStride, int flags,
+	int &result)
+{
+	FdStream stream(fd);
+	
+	switch (getImageFormat(EMPTY_STRING, type)) {
+	case CG_FILE_FORMAT_BMP:
+		return writeBMP(stream, dataFormat, width, height, r, g, b, a, rowStride, flags, result);
+	default:
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	}
+}
+
+int decodeImage(
+	const char *data, size_t size, int dataFormat, int maxWidth, int maxHeight,
+	int &width, int &height, void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	// NOTE: The bitmap is extracted directly from the caller's buffer.
+	MemoryStream stream(data, size);
+	
+	switch (getBufferImageFormat(data, size)) {
+	case CG_FILE_FORMAT_BMP:
+		return readBMP(
+			stream, dataFormat, maxWidth, maxHeight, width, height, r, g, b, a, rowStride, flags,
+			result);
+	default:
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	}
+}
+
+int getEncodedSize(
+	const std::string &type, int width, int height, bool withAlpha, size_t &size, int &result)
+{
+	if (width <= 0 || height <= 0)
+		return result = CGRESULT_BAD_DIMENSION;
+	
+	switch (getImageFormat(EMPTY_STRING, type)) {
+	case CG_FILE_FORMAT_BMP: {
+		unsigned long long rowBytes = bitmapRowBytes((withAlpha) ? 32 : 24, width);
+		if (rowBytes > (MAX_BMP_FILE_SIZE - 54) / height)
+			return result = CGRESULT_BAD_DIMENSION;
+		size = (size_t)(54 + rowBytes * height);
+		return result = CGRESULT_OK;
+	}
+	default:
+		return result = CGRESULT_UNSUPPORTED_FORMAT;
+	}
+}
+
+// NOTE: The size of the encoded image is checked against the capacity of the buffer before
+// anything is written, and is returned in size even if the buffer is too small.
+int encodeImage(
+	const std::string &type, int dataFormat, int width, int height,
+	const void *r, const void *g, const void *b, const void *a, int rowStride, int flags,
+	void *out, size_t capacity, size_t &size,
+	int &result)
+{
+	// NOTE: The size of a quantized image is not known before it is encoded.
+	if (flags & CG_FLAG_INDEXED)
+		return result = CGRESULT_INVALID_ARGUMENT;
+	if (getEncodedSize(type, width, height, a != 0, size, result) != CGRESULT_OK)
+		return result;
+	if (size > capacity)
+		return result = CGRESULT_BUFFER_TOO_SMALL;
+	
+	MemoryStream stream(out, capacity);
+	return writeBMP(stream, dataFormat, width, height, r, g, b, a, rowStride, flags, result);
+}
+
+// NOTE: Reads through the cache of the current context if it is enabled. On a miss, the image
+// is decoded into a new entry outside the lock, and then copied to the caller's buffers. An
+// image too large for the cache is read directly instead.
+int readImageCached(
+	const std::string &path, const std::string &type, int dataFormat, int maxWidth, int maxHeight,
+	int &width, int &height, void *r, void *g, void *b, void *a, int rowStride, int flags,
+	int &result)
+{
+	struct stat st;
+	size_t maxBytes = 0;
+	DecodeCache *cache = currentDecodeCache();
+	
+	if (cache) {
+		CacheLock lock(*cache);
+		maxBytes = cache->maxBytes;
+	}
+	
+	if (maxBytes == 0 || getImageFormat(path, type) != CG_FILE_FORMAT_BMP ||
+		stat(path.c_str(), &st) != 0 || channelSize(dataFormat) == 0)
+	{
+		return readImage(
+			path, type, dataFormat, maxWidth, maxHeight, width, height, r, g, b, a,
+			rowStride, flags, result);
+	}
+	
+	CacheKey key;
+	key.path = path;
+	key.size = (long long)st.st_size;
+	key.mtime = (long long)st.st_mtime;
+	key.dataFormat = dataFormat;
+	
+	CacheEntryPtr held;
+	
+	{
+		CacheLock lock(*cache);
+		std::map<CacheKey, CacheList::iterator>::iterator found = cache->index.find(key);
+		if (found != cache->index.end()) {
+			CacheList::iterator it = found->second;
+			cache->entries.splice(cache->entries.begin(), cache->entries, it);
+			cache->hits++;
+			held = *it;
+		}
+		else {
+			cache->misses++;
+		}
+	}
+	
+	if (held) {
+		width = held->width;
+		height = held->height;
+		if (width > maxWidth || height > maxHeight)
+			return result = CGRESULT_BAD_DIMENSION;
+		return copyCachedImage(*held, r, g, b, a, rowStride, flags, result);
+	}
+	
+	// Read the header for the size of the image, then decode all channels of it.
+	FILE *fptr = openFile(path.c_str(), "rb");
+	if (!fptr)
+		return result = CGRESULT_FOPEN_FAILED;
+	
+	FileStream stream(fptr);
+	BMPInfo info;
+	size_t planeBytes = 0;
+	if (readBMPHeader(stream, maxWidth, maxHeight, info, result) == CGRESULT_OK)
+		planeBytes = channelSize(dataFormat) * info.width * info.height;
+	
+	if (result == CGRESULT_OK && 4 * planeBytes > maxBytes) {
+		closeFile(fptr);
+		return readImage(
+			path, type, dataFormat, maxWidth, maxHeight, width, height, r, g, b, a,
+			rowStride, flags, result);
+	}
+	
+	std::shared_ptr<CacheEntry> entry(new CacheEntry);
+	entry->key = key;
+	
+	if (result == CGRESULT_OK) {
+		if (stream.seek(0, SEEK_SET)) {
+			result = CGRESULT_SEEK_ERROR;
+		}
+		else {
+			entry->planes.resize(4 * planeBytes);
+			char *p = &entry->planes[0];
+			readBMP(
+				stream, dataFormat, maxWidth, maxHeight, entry->width, entry->height,
+				p, p + planeBytes, p + 2*planeBytes, p + 3*planeBytes, 0, 0, result);
+		}
+	}
+	
+	if (closeFile(fptr) && result == CGRESULT_OK)
+		result = CGRESULT_FCLOSE_FAILED;
+	if (result != CGRESULT_OK)
+		return result;
+	
+	width = entry->width;
+	height = entry->height;
+	if (copyCachedImage(*entry, r, g, b, a, rowStride, flags, result) != CGRESULT_OK)
+		return result;
+	
+	{
+		CacheLock lock(*cache);
+		size_t entryBytes = entry->planes.size();
+		bool cached = cache->index.find(key) != cache->index.end();
+		
+		if (!cached && entryBytes <= cache->maxBytes) {
+			evictCachedImages(*cache, cache->maxBytes - entryBytes);
+			cache->entries.push_front(entry);
+			cache->index[key] = cache->entries.begin();
+			cache->bytes += entryBytes;
+		}
+	}
+	
+	return result;
+}
+
+} // end anonymous namespace
+
+
+// Context Decode Caches
+void destroyDecodeCache(DecodeCache *cache) {
+	if (!cache)
+		return;
+	
+	#pragma omp critical(cgDecodeCache)
+	contextDecodeCaches.erase(
+		std::find(contextDecodeCaches.begin(), contextDecodeCaches.end(), cache));
+	
+	delete cache;
+}
+
+
+// Row Streaming State
+struct cg_image_reader {
+	FILE *fptr;
+	long long bitmapOffset;
+	BMPInfo info;
+	RLEDecoder decoder;
+	PaletteTables palette;
+	int dataFormat;
+	int rowsRead;
+};
+
+struct cg_image_writer {
+	FILE *fptr;
+	int dataFormat;
+	int width;
+	int height;
+	int bytesPerPixel;
+	int rowsWritten;
+};
+
+
+// Public Interface
+void graphics_init(int *out_result) {
+	// NOTE: Nothing to to here at present.
+	*out_result = CGRESULT_OK;
+}
+
+void graphics_configureDecodeCache(const long long *max_bytes, int *out_result) {
+	if (*max_bytes < 0) {
+		*out_result = CGRESULT_INVALID_ARGUMENT;
+		return;
+	}
+	
+	*out_result = CGRESULT_OK;
+	
+	DecodeCache *cache = currentDecodeCache();
+	if (!cache) {
+		if (*max_bytes == 0)
+			return;
+		
+		cache = new DecodeCache;
+		if (!cache) {
+			*out_result = CGRESULT_ALLOC_FAILED;
+			return;
+		}
+		
+		threadContext()->decodeCache = cache;
+		
+		#pragma omp critical(cgDecodeCache)
+		contextDecodeCaches.push_back(cache);
+	}
+	
+	CacheLock lock(*cache);
+	cache->maxBytes = (size_t)*max_bytes;
+	evictCachedImages(*cache, cache->maxBytes);
+}
+
+void graphics_getDecodeCacheStats(
+	long long *out_hits, long long *out_misses, long long *out_bytes, int *out_entries,
+	int *out_result)
+{
+	*out_hits = 0;
+	*out_misses = 0;
+	*out_bytes = 0;
+	*out_entries = 0;
+	
+	DecodeCache *cache = currentDecodeCache();
+	if (cache) {
+		CacheLock lock(*cache);
+		*out_hits = cache->hits;
+		*out_misses = cache->misses;
+		*out_bytes = (long long)cache->bytes;
+		*out_entries = (int)cache->entries.size();
+	}
+	
+	*out_result = CGRESULT_OK;
+}
+
+void graphics_getStats(
+	long long *out_counts, long long *out_nanoseconds, long long *out_bytes,
+	long long *out_pixels,
+	int *out_result)
+{
+	for (int i = 0; i < CG_STAT_COUNT; i++) {
+		StageStats stats = { 0, 0, 0, 0 };
+#ifdef CG_GRAPHDLL_STATS
+		StageStats &total = currentContext().stats[i];
+		#pragma omp atomic read
+		stats.count = total.count;
+		#pragma omp atomic read
+		stats.nanoseconds = total.nanoseconds;
+		#pragma omp atomic read
+		stats.bytes = total.bytes;
+		#pragma omp atomic read
+		stats.pixels = total.pixels;
+#endif
+		if (out_counts)      { out_counts[i] = stats.count; }
+		if (out_nanoseconds) { out_nanoseconds[i] = stats.nanoseconds; }
+		if (out_bytes)       { out_bytes[i] = stats.bytes; }
+		if (out_pixels)      { out_pixels[i] = stats.pixels; }
+	}
+	
+	*out_result = CGRESULT_OK;
+}
+
+void graphics_resetStats(int *out_result) {
+#ifdef CG_GRAPHDLL_STATS
+	for (int i = 0; i < CG_STAT_COUNT; i++) {
+		StageStats &total = currentContext().stats[i];
+		#pragma omp atomic write
+		total.count = 0;
+		#pragma omp atomic write
+		total.nanoseconds = 0;
+		#pragma omp atomic write
+		total.bytes = 0;
+		#pragma omp atomic write
+		total.pixels = 0;
+	}
+#endif
+	
+	*out_result = CGRESULT_OK;
+}
+
+void graphics_convertRGBtoHCL(
+	const int *width, const int *height, const double *r, const double *g, const double *b,
+	double *out_h, double *out_c, double *out_l,
+	int *out_result)
+{
+	convertImageRGBtoHCL<DoubleChannels>(
+		*width, *height, 0, r, g, b, 0, out_h, out_c, out_l, *out_result);
+}
+
+void graphics_convertHCLtoRGB(
+	const int *width, const int *height, const double *h, const double *c, const double *l,
+	double *out_r, double *out_g, double *out_b,
+	int *out_result)
+{
+	convertImageHCLtoRGB<DoubleChannels>(
+		*width, *height, 0, h, c, l, 0, out_r, out_g, out_b, *out_result);
+}
+
+void graphics_readImageRGB(
+	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, double *out_r, double *out_g, double *out_b, double *out_a,
+	int *out_result)
+{
+	readImageCached(
+		file_name, file_type, CG_DATA_FORMAT_RGB, *max_width, *max_height,
+		*out_width, *out_height, out_r, out_g, out_b, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_writeImageRGB(
+	const char *file_name, const char *file_type, const int *width, const int *height,
+	const double *r, const double *g, const double *b, const double *a,
+	int *out_result)
+{
+	writeImage(
+		file_name, file_type, CG_DATA_FORMAT_RGB, *width, *height,
+		r, g, b, a, 0, 0,
+		*out_result);
+}
+
+void graphics_readImageHCL(
+	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, double *out_h, double *out_c, double *out_l, double *out_a,
+	int *out_result)
+{
+	readImageCached(
+		file_name, file_type, CG_DATA_FORMAT_HCL, *max_width, *max_height,
+		*out_width, *out_height, out_h, out_c, out_l, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_writeImageHCL(
+	const char *file_name, const char *file_type, const int *width, const int *height,
+	const double *h, const double *c, const double *l, const double *a,
+	int *out_result)
+{
+	writeImage(
+		file_name, file_type, CG_DATA_FORMAT_HCL, *width, *height,
+		h, c, l, a, 0, 0,
+		*out_result);
+}
+
+void graphics_convertBytesRGBtoHCL(
+	const int *width, const int *height, const uchar *r, const uchar *g, const uchar *b,
+	uchar *out_h, uchar *out_c, uchar *out_l,
+	int *out_result)
+{
+	convertImageRGBtoHCL<ByteChannels>(
+		*width, *height, 0, r, g, b, 0, out_h, out_c, out_l, *out_result);
+}
+
+void graphics_convertBytesHCLtoRGB(
+	const int *width, const int *height, const uchar *h, const uchar *c, const uchar *l,
+	uchar *out_r, uchar *out_g, uchar *out_b,
+	int *out_result)
+{
+	convertImageHCLtoRGB<ByteChannels>(
+		*width, *height, 0, h, c, l, 0, out_r, out_g, out_b, *out_result);
+}
+
+void graphics_readImageBytesRGB(
+	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, uchar *out_r, uchar *out_g, uchar *out_b, uchar *out_a,
+	int *out_result)
+{
+	readImageCached(
+		file_name, file_type, CG_DATA_FORMAT_RGB_BYTES, *max_width, *max_height,
+		*out_width, *out_height, out_r, out_g, out_b, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_writeImageBytesRGB(
+	const char *file_name, const char *file_type, const int *width, const int *height,
+	const uchar *r, const uchar *g, const uchar *b, const uchar *a,
+	int *out_result)
+{
+	writeImage(
+		file_name, file_type, CG_DATA_FORMAT_RGB_BYTES, *width, *height,
+		r, g, b, a, 0, 0,
+		*out_result);
+}
+
+void graphics_readImageBytesHCL(
+	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, uchar *out_h, uchar *out_c, uchar *out_l, uchar *out_a,
+	int *out_result)
+{
+	readImageCached(
+		file_name, file_type, CG_DATA_FORMAT_HCL_BYTES, *max_width, *max_height,
+		*out_width, *out_height, out_h, out_c, out_l, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_writeImageBytesHCL(
+	const char *file_name, const char *file_type, const int *width, const int *height,
+	const uchar *h, const uchar *c, const uchar *l, const uchar *a,
+	int *out_result)
+{
+	writeImage(
+		file_name, file_type, CG_DATA_FORMAT_HCL_BYTES, *width, *height,
+		h, c, l, a, 0, 0,
+		*out_result);
+}
+
+void graphics_readImageRegionRGB(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	double *out_r, double *out_g, double *out_b, double *out_a,
+	int *out_result)
+{
+	readImageRegion(
+		file_name, file_type, CG_DATA_FORMAT_RGB, *x, *y, *width, *height,
+		out_r, out_g, out_b, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_readImageRegionHCL(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	double *out_h, double *out_c, double *out_l, double *out_a,
+	int *out_result)
+{
+	readImageRegion(
+		file_name, file_type, CG_DATA_FORMAT_HCL, *x, *y, *width, *height,
+		out_h, out_c, out_l, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_readImageRegionBytesRGB(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	uchar *out_r, uchar *out_g, uchar *out_b, uchar *out_a,
+	int *out_result)
+{
+	readImageRegion(
+		file_name, file_type, CG_DATA_FORMAT_RGB_BYTES, *x, *y, *width, *height,
+		out_r, out_g, out_b, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_readImageRegionBytesHCL(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	uchar *out_h, uchar *out_c, uchar *out_l, uchar *out_a,
+	int *out_result)
+{
+	readImageRegion(
+		file_name, file_type, CG_DATA_FORMAT_HCL_BYTES, *x, *y, *width, *height,
+		out_h, out_c, out_l, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_readImageDecimatedRGB(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	double *out_r, double *out_g, double *out_b, double *out_a,
+	int *out_result)
+{
+	readImageDecimated(
+		file_name, file_type, CG_DATA_FORMAT_RGB, *factor, *max_width, *max_height,
+		*out_width, *out_height, out_r, out_g, out_b, out_a,
+		*out_result);
+}
+
+void graphics_readImageDecimatedHCL(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	double *out_h, double *out_c, double *out_l, double *out_a,
+	int *out_result)
+{
+	readImageDecimated(
+		file_name, file_type, CG_DATA_FORMAT_HCL, *factor, *max_width, *max_height,
+		*out_width, *out_height, out_h, out_c, out_l, out_a,
+		*out_result);
+}
 
+void graphics_readImageDecimatedBytesRGB(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	uchar *out_r, uchar *out_g, uchar *out_b, uchar *out_a,
+	int *out_result)
+{
+	readImageDecimated(
+		file_name, file_type, CG_DATA_FORMAT_RGB_BYTES, *factor, *max_width, *max_height,
+		*out_width, *out_height, out_r, out_g, out_b, out_a,
+		*out_result);
+}
 
-// Public Interface
-void graphics_init(int *out_result) {
-	// NOTE: Nothing to to here at present.
-	*out_result = CGRESULT_OK;
+void graphics_readImageDecimatedBytesHCL(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	uchar *out_h, uchar *out_c, uchar *out_l, uchar *out_a,
+	int *out_result)
+{
+	readImageDecimated(
+		file_name, file_type, CG_DATA_FORMAT_HCL_BYTES, *factor, *max_width, *max_height,
+		*out_width, *out_height, out_h, out_c, out_l, out_a,
+		*out_result);
 }
 
-void graphics_convertRGBtoHCL(
-	const int *width, const int *height, const double *r, const double *g, const double *b,
-	double *out_h, double *out_c, double *out_l,
+void graphics_convertRGBtoHCLEx(
+	const int *width, const int *height,
+	const int *in_stride, const double *r, const double *g, const double *b,
+	const int *out_stride, double *out_h, double *out_c, double *out_l,
 	int *out_result)
 {
-	int totalPixels = *width * *height;
-	for (int i = 0; i < totalPixels; i++)
-		convertRGBtoHCL(r[i], g[i], b[i], out_h[i], out_c[i], out_l[i]);
-	*out_result = CGRESULT_OK;
+	convertImageRGBtoHCL<DoubleChannels>(
+		*width, *height, *in_stride, r, g, b, *out_stride, out_h, out_c, out_l, *out_result);
 }
 
-void graphics_convertHCLtoRGB(
-	const int *width, const int *height, const double *h, const double *c, const double *l,
-	double *out_r, double *out_g, double *out_b,
+void graphics_convertHCLtoRGBEx(
+	const int *width, const int *height,
+	const int *in_stride, const double *h, const double *c, const double *l,
+	const int *out_stride, double *out_r, double *out_g, double *out_b,
 	int *out_result)
 {
-	int totalPixels = *width * *height;
-	for (int i = 0; i < totalPixels; i++)
-		convertHCLtoRGB(h[i], c[i], l[i], out_r[i], out_g[i], out_b[i]);
-	*out_result = CGRESULT_OK;
+	convertImageHCLtoRGB<DoubleChannels>(
+		*width, *height, *in_stride, h, c, l, *out_stride, out_r, out_g, out_b, *out_result);
 }
 
-void graphics_readImageRGB(
-	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
-	int *out_width, int *out_height, double *out_r, double *out_g, double *out_b, double *out_a,
+void graphics_convertBytesRGBtoHCLEx(
+	const int *width, const int *height,
+	const int *in_stride, const uchar *r, const uchar *g, const uchar *b,
+	const int *out_stride, uchar *out_h, uchar *out_c, uchar *out_l,
 	int *out_result)
 {
-	readImage(
-		file_name, file_type, CG_DATA_FORMAT_RGB, *max_width, *max_height,
-		*out_width, *out_height, out_r, out_g, out_b, out_a,
-		*out_result);
+	convertImageRGBtoHCL<ByteChannels>(
+		*width, *height, *in_stride, r, g, b, *out_stride, out_h, out_c, out_l, *out_result);
 }
 
-void graphics_writeImageRGB(
-	const char *file_name, const char *file_type, const int *width, const int *height,
-	const double *r, const double *g, const double *b, const double *a,
+void graphics_convertBytesHCLtoRGBEx(
+	const int *width, const int *height,
+	const int *in_stride, const uchar *h, const uchar *c, const uchar *l,
+	const int *out_stride, uchar *out_r, uchar *out_g, uchar *out_b,
 	int *out_result)
 {
-	writeImage(
-		file_name, file_type, CG_DATA_FORMAT_RGB, *width, *height,
-		r, g, b, a,
+	convertImageHCLtoRGB<ByteChannels>(
+		*width, *height, *in_stride, h, c, l, *out_stride, out_r, out_g, out_b, *out_result);
+}
+
+void graphics_readImageEx(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *max_width, const int *max_height, const int *row_stride, const int *flags,
+	int *out_width, int *out_height, void *out_1, void *out_2, void *out_3, void *out_4,
+	int *out_result)
+{
+	readImageCached(
+		file_name, file_type, *data_format, *max_width, *max_height,
+		*out_width, *out_height, out_1, out_2, out_3, out_4, *row_stride, *flags,
 		*out_result);
 }
 
-void graphics_readImageHCL(
-	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
-	int *out_width, int *out_height, double *out_h, double *out_c, double *out_l, double *out_a,
+void graphics_readImageRegionEx(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *x, const int *y, const int *width, const int *height,
+	const int *row_stride, const int *flags,
+	void *out_1, void *out_2, void *out_3, void *out_4,
 	int *out_result)
 {
-	readImage(
-		file_name, file_type, CG_DATA_FORMAT_HCL, *max_width, *max_height,
-		*out_width, *out_height, out_h, out_c, out_l, out_a,
+	readImageRegion(
+		file_name, file_type, *data_format, *x, *y, *width, *height,
+		out_1, out_2, out_3, out_4, *row_stride, *flags,
 		*out_result);
 }
 
-void graphics_writeImageHCL(
-	const char *file_name, const char *file_type, const int *width, const int *height,
-	const double *h, const double *c, const double *l, const double *a,
+void graphics_writeImageEx(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const void *in_1, const void *in_2, const void *in_3, const void *in_4,
 	int *out_result)
 {
 	writeImage(
-		file_name, file_type, CG_DATA_FORMAT_HCL, *width, *height,
-		h, c, l, a,
+		file_name, file_type, *data_format, *width, *height,
+		in_1, in_2, in_3, in_4, *row_stride, *flags,
 		*out_result);
 }
 
-void graphics_convertBytesRGBtoHCL(
-	const int *width, const int *height, const uchar *r, const uchar *g, const uchar *b,
-	uchar *out_h, uchar *out_c, uchar *out_l,
+void graphics_writeIndexedImage(
+	const char *file_name, const char *file_type,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const uchar *indices, const int *palette_size,
+	const uchar *palette_r, const uchar *palette_g, const uchar *palette_b,
 	int *out_result)
 {
-	int totalPixels = *width * *height;
-	for (int i = 0; i < totalPixels; i++) {
-		double rd = doubleFrom8bit(r[i]);
-		double gd = doubleFrom8bit(g[i]);
-		double bd = doubleFrom8bit(b[i]);
-		double hd, cd, ld;
-		convertRGBtoHCL(rd, gd, bd, hd, cd, ld);
-		out_h[i] = (uchar)doubleTo8bit(hd / 6.0);
-		out_c[i] = (uchar)doubleTo8bit(cd);
-		out_l[i] = (uchar)doubleTo8bit(ld);
+	if (*palette_size <= 0 || *palette_size > 256) {
+		*out_result = CGRESULT_INVALID_ARGUMENT;
+		return;
 	}
-	*out_result = CGRESULT_OK;
+	
+	unsigned int palette[256];
+	for (int i = 0; i < *palette_size; i++)
+		palette[i] = (unsigned int)palette_r[i] << 16 | (unsigned int)palette_g[i] << 8 | palette_b[i];
+	
+	writeIndexedImage(
+		file_name, file_type, *width, *height, indices, *row_stride, *flags,
+		palette, *palette_size,
+		*out_result);
 }
 
-void graphics_convertBytesHCLtoRGB(
-	const int *width, const int *height, const uchar *h, const uchar *c, const uchar *l,
-	uchar *out_r, uchar *out_g, uchar *out_b,
+void graphics_readImageFd(
+	const int *fd, const int *data_format,
+	const int *max_width, const int *max_height, const int *row_stride, const int *flags,
+	int *out_width, int *out_height, void *out_1, void *out_2, void *out_3, void *out_4,
 	int *out_result)
 {
-	int totalPixels = *width * *height;
-	for (int i = 0; i < totalPixels; i++) {
-		double hd = 6.0 * doubleFrom8bit(h[i]);
-		double cd =       doubleFrom8bit(c[i]);
-		double ld =       doubleFrom8bit(l[i]);
-		double rd, gd, bd;
-		convertHCLtoRGB(hd, cd, ld, rd, gd, bd);
-		out_r[i] = (uchar)doubleTo8bit(rd);
-		out_g[i] = (uchar)doubleTo8bit(gd);
-		out_b[i] = (uchar)doubleTo8bit(bd);
-	}
-	*out_result = CGRESULT_OK;
+	readImageFd(
+		*fd, *data_format, *max_width, *max_height,
+		*out_width, *out_height, out_1, out_2, out_3, out_4, *row_stride, *flags,
+		*out_result);
 }
 
-void graphics_readImageBytesRGB(
-	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
+void graphics_writeImageFd(
+	const int *fd, const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const void *in_1, const void *in_2, const void *in_3, const void *in_4,
+	int *out_result)
+{
+	writeImageFd(
+		*fd, file_type, *data_format, *width, *height, in_1, in_2, in_3, in_4, *row_stride, *flags,
+		*out_result);
+}
+
+void graphics_decodeImageRGB(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, double *out_r, double *out_g, double *out_b, double *out_a,
+	int *out_result)
+{
+	decodeImage(
+		(const char *)data, (size_t)*size, CG_DATA_FORMAT_RGB, *max_width, *max_height,
+		*out_width, *out_height, out_r, out_g, out_b, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_encodeImageRGB(
+	const char *file_type, const int *width, const int *height,
+	const double *r, const double *g, const double *b, const double *a,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result)
+{
+	size_t size = 0;
+	encodeImage(
+		file_type, CG_DATA_FORMAT_RGB, *width, *height, r, g, b, a, 0, 0,
+		out_data, (size_t)*capacity, size,
+		*out_result);
+	*out_size = (long long)size;
+}
+
+void graphics_decodeImageHCL(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, double *out_h, double *out_c, double *out_l, double *out_a,
+	int *out_result)
+{
+	decodeImage(
+		(const char *)data, (size_t)*size, CG_DATA_FORMAT_HCL, *max_width, *max_height,
+		*out_width, *out_height, out_h, out_c, out_l, out_a, 0, 0,
+		*out_result);
+}
+
+void graphics_encodeImageHCL(
+	const char *file_type, const int *width, const int *height,
+	const double *h, const double *c, const double *l, const double *a,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result)
+{
+	size_t size = 0;
+	encodeImage(
+		file_type, CG_DATA_FORMAT_HCL, *width, *height, h, c, l, a, 0, 0,
+		out_data, (size_t)*capacity, size,
+		*out_result);
+	*out_size = (long long)size;
+}
+
+void graphics_decodeImageBytesRGB(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
 	int *out_width, int *out_height, uchar *out_r, uchar *out_g, uchar *out_b, uchar *out_a,
 	int *out_result)
 {
-	readImage(
-		file_name, file_type, CG_DATA_FORMAT_RGB_BYTES, *max_width, *max_height,
-		*out_width, *out_height, out_r, out_g, out_b, out_a,
+	decodeImage(
+		(const char *)data, (size_t)*size, CG_DATA_FORMAT_RGB_BYTES, *max_width, *max_height,
+		*out_width, *out_height, out_r, out_g, out_b, out_a, 0, 0,
 		*out_result);
 }
 
-void graphics_writeImageBytesRGB(
-	const char *file_name, const char *file_type, const int *width, const int *height,
+void graphics_encodeImageBytesRGB(
+	const char *file_type, const int *width, const int *height,
 	const uchar *r, const uchar *g, const uchar *b, const uchar *a,
+	void *out_data, const long long *capacity, long long *out_size,
 	int *out_result)
 {
-	writeImage(
-		file_name, file_type, CG_DATA_FORMAT_RGB_BYTES, *width, *height,
-		r, g, b, a,
+	size_t size = 0;
+	encodeImage(
+		file_type, CG_DATA_FORMAT_RGB_BYTES, *width, *height, r, g, b, a, 0, 0,
+		out_data, (size_t)*capacity, size,
 		*out_result);
+	*out_size = (long long)size;
 }
 
-void graphics_readImageBytesHCL(
-	const char *file_name, const char *file_type, const int *max_width, const int *max_height,
+void graphics_decodeImageBytesHCL(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
 	int *out_width, int *out_height, uchar *out_h, uchar *out_c, uchar *out_l, uchar *out_a,
 	int *out_result)
 {
-	readImage(
-		file_name, file_type, CG_DATA_FORMAT_HCL_BYTES, *max_width, *max_height,
-		*out_width, *out_height, out_h, out_c, out_l, out_a,
+	decodeImage(
+		(const char *)data, (size_t)*size, CG_DATA_FORMAT_HCL_BYTES, *max_width, *max_height,
+		*out_width, *out_height, out_h, out_c, out_l, out_a, 0, 0,
 		*out_result);
 }
 
-void graphics_writeImageBytesHCL(
-	const char *file_name, const char *file_type, const int *width, const int *height,
+void graphics_encodeImageBytesHCL(
+	const char *file_type, const int *width, const int *height,
 	const uchar *h, const uchar *c, const uchar *l, const uchar *a,
+	void *out_data, const long long *capacity, long long *out_size,
 	int *out_result)
 {
-	writeImage(
-		file_name, file_type, CG_DATA_FORMAT_HCL_BYTES, *width, *height,
-		h, c, l, a,
+	size_t size = 0;
+	encodeImage(
+		file_type, CG_DATA_FORMAT_HCL_BYTES, *width, *height, h, c, l, a, 0, 0,
+		out_data, (size_t)*capacity, size,
+		*out_result);
+	*out_size = (long long)size;
+}
+
+void graphics_decodeImageEx(
+	const void *data, const long long *size, const int *data_format,
+	const int *max_width, const int *max_height, const int *row_stride, const int *flags,
+	int *out_width, int *out_height, void *out_1, void *out_2, void *out_3, void *out_4,
+	int *out_result)
+{
+	decodeImage(
+		(const char *)data, (size_t)*size, *data_format, *max_width, *max_height,
+		*out_width, *out_height, out_1, out_2, out_3, out_4, *row_stride, *flags,
+		*out_result);
+}
+
+void graphics_encodeImageEx(
+	const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const void *in_1, const void *in_2, const void *in_3, const void *in_4,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result)
+{
+	size_t size = 0;
+	encodeImage(
+		file_type, *data_format, *width, *height, in_1, in_2, in_3, in_4, *row_stride, *flags,
+		out_data, (size_t)*capacity, size,
+		*out_result);
+	*out_size = (long long)size;
+}
+
+void graphics_getEncodedImageSize(
+	const char *file_type, const int *width, const int *height, const int *with_alpha,
+	long long *out_size,
+	int *out_result)
+{
+	size_t size = 0;
+	getEncodedSize(file_type, *width, *height, *with_alpha != 0, size, *out_result);
+	*out_size = (long long)size;
+}
+
+void graphics_openImageReader(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *max_width, const int *max_height,
+	cg_image_reader **out_reader, int *out_width, int *out_height,
+	int *out_result)
+{
+	*out_reader = 0;
+	
+	Extractor rx, gx, bx, ax;
+	if (selectExtractors(*data_format, 0, 0, 0, 0, rx, gx, bx, ax, *out_result) != CGRESULT_OK)
+		return;
+	
+	if (getImageFormat(file_name, file_type) != CG_FILE_FORMAT_BMP) {
+		*out_result = CGRESULT_UNSUPPORTED_FORMAT;
+		return;
+	}
+	
+	FILE *fptr = openFile(file_name, "rb");
+	if (!fptr) {
+		*out_result = CGRESULT_FOPEN_FAILED;
+		return;
+	}
+	
+	cg_image_reader *reader = new cg_image_reader;
+	reader->fptr = fptr;
+	reader->dataFormat = *data_format;
+	reader->rowsRead = 0;
+	
+	FileStream stream(fptr);
+	if (readBMPHeader(stream, *max_width, *max_height, reader->info, *out_result) != CGRESULT_OK) {
+		closeFile(fptr);
+		delete reader;
+		return;
+	}
+	
+	reader->decoder.reset(reader->info);
+	if (reader->info.bitsPerPixel <= 8 &&
+		buildPaletteTables(reader->info, *data_format, reader->palette, *out_result) != CGRESULT_OK)
+	{
+		closeFile(fptr);
+		delete reader;
+		return;
+	}
+	
+	reader->bitmapOffset = stream.tell();
+	if (reader->bitmapOffset < 0) {
+		closeFile(fptr);
+		delete reader;
+		*out_result = CGRESULT_SEEK_ERROR;
+		return;
+	}
+	
+	*out_width = reader->info.width;
+	*out_height = reader->info.height;
+	*out_reader = reader;
+}
+
+void graphics_readImageRows(
+	cg_image_reader *reader, const int *row_count,
+	void *out_r, void *out_g, void *out_b, void *out_a,
+	int *out_result)
+{
+	if (*row_count < 0 || *row_count > reader->info.height - reader->rowsRead) {
+		*out_result = CGRESULT_BAD_DIMENSION;
+		return;
+	}
+	
+	const BMPInfo &info = reader->info;
+	FileStream stream(reader->fptr);
+	
+	if (!info.topDown) {
+		readBMPRows(
+			stream, info, reader->decoder, reader->palette, reader->dataFormat, *row_count,
+			out_r, out_g, out_b, out_a, 0,
+			*out_result);
+	}
+	else {
+		// NOTE: The rows of a top-down bitmap are still streamed bottom-to-top, by seeking to
+		// each row in turn.
+		unsigned long long bytesPerRow = bitmapRowBytes(info.bitsPerPixel, info.width);
+		
+		*out_result = CGRESULT_OK;
+		
+		for (int i = 0; i < *row_count && *out_result == CGRESULT_OK; i++) {
+			int fileRow = info.height - 1 - (reader->rowsRead + i);
+			if (stream.seek(reader->bitmapOffset + (long long)(bytesPerRow * fileRow), SEEK_SET)) {
+				*out_result = CGRESULT_SEEK_ERROR;
+				break;
+			}
+			
+			readBMPRows(
+				stream, info, reader->decoder, reader->palette, reader->dataFormat, 1,
+				out_r, out_g, out_b, out_a, 0,
+				*out_result);
+			advanceChannels(
+				(ptrdiff_t)channelSize(reader->dataFormat) * info.width, out_r, out_g, out_b, out_a);
+		}
+	}
+	
+	if (*out_result == CGRESULT_OK)
+		reader->rowsRead += *row_count;
+}
+
+void graphics_closeImageReader(cg_image_reader *reader, int *out_result) {
+	*out_result = CGRESULT_OK;
+	
+	if (!reader)
+		return;
+	
+	int closeResult = closeFile(reader->fptr);
+	if (closeResult)
+		*out_result = CGRESULT_FCLOSE_FAILED;
+	
+	delete reader;
+}
+
+void graphics_openImageWriter(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *with_alpha,
+	cg_image_writer **out_writer,
+	int *out_result)
+{
+	*out_writer = 0;
+	
+	Packer3 p3;
+	Packer4 p4;
+	if (selectPackers(*data_format, p3, p4, *out_result) != CGRESULT_OK)
+		return;
+	
+	if (*width <= 0 || *height <= 0) {
+		*out_result = CGRESULT_BAD_DIMENSION;
+		return;
+	}
+	
+	if (getImageFormat(file_name, file_type) != CG_FILE_FORMAT_BMP) {
+		*out_result = CGRESULT_UNSUPPORTED_FORMAT;
+		return;
+	}
+	
+	dropCachedImages(file_name);
+	
+	FILE *fptr = openFile(file_name, "wb");
+	if (!fptr) {
+		*out_result = CGRESULT_FOPEN_FAILED;
+		return;
+	}
+	
+	int bytesPerPixel = (*with_alpha) ? 4 : 3;
+	FileStream stream(fptr);
+	if (writeBMPHeader(stream, *width, *height, bytesPerPixel, *out_result) != CGRESULT_OK) {
+		closeFile(fptr);
+		return;
+	}
+	
+	cg_image_writer *writer = new cg_image_writer;
+	writer->fptr = fptr;
+	writer->dataFormat = *data_format;
+	writer->width = *width;
+	writer->height = *height;
+	writer->bytesPerPixel = bytesPerPixel;
+	writer->rowsWritten = 0;
+	*out_writer = writer;
+}
+
+void graphics_writeImageRows(
+	cg_image_writer *writer, const int *row_count,
+	const void *r, const void *g, const void *b, const void *a,
+	int *out_result)
+{
+	if (*row_count < 0 || *row_count > writer->height - writer->rowsWritten) {
+		*out_result = CGRESULT_BAD_DIMENSION;
+		return;
+	}
+	
+	FileStream stream(writer->fptr);
+	writeBMPRows(
+		stream, writer->dataFormat, writer->width, writer->bytesPerPixel, *row_count,
+		r, g, b, a, 0,
+		*out_result);
+	
+	if (*out_result == CGRESULT_OK)
+		writer->rowsWritten += *row_count;
+}
+
+void graphics_closeImageWriter(cg_image_writer *writer, int *out_result) {
+	*out_result = CGRESULT_OK;
+	
+	if (!writer)
+		return;
+	
+	if (writer->rowsWritten < writer->height)
+		*out_result = CGRESULT_INCOMPLETE_WRITE;
+	
+	int closeResult = closeFile(writer->fptr);
+	if (closeResult)
+		*out_result = CGRESULT_FCLOSE_FAILED;
+	
+	delete writer;
+}
+
+void graphics_compareImageFiles(
+	const char *file_name_1, const char *file_name_2, const char *file_type,
+	const int *tile_width, const int *tile_height, const int *max_tiles,
+	int *out_equal, int *out_tiles_x, int *out_tiles_y, uchar *out_tile_map,
+	int *out_result)
+{
+	if (*tile_width <= 0 || *tile_height <= 0) {
+		*out_result = CGRESULT_INVALID_ARGUMENT;
+		return;
+	}
+	
+	if (getImageFormat(file_name_1, file_type) != CG_FILE_FORMAT_BMP ||
+		getImageFormat(file_name_2, file_type) != CG_FILE_FORMAT_BMP)
+	{
+		*out_result = CGRESULT_UNSUPPORTED_FORMAT;
+		return;
+	}
+	
+	FILE *fptr1 = openFile(file_name_1, "rb");
+	if (!fptr1) {
+		*out_result = CGRESULT_FOPEN_FAILED;
+		return;
+	}
+	
+	FILE *fptr2 = openFile(file_name_2, "rb");
+	if (!fptr2) {
+		closeFile(fptr1);
+		*out_result = CGRESULT_FOPEN_FAILED;
+		return;
+	}
+	
+	FileStream stream1(fptr1), stream2(fptr2);
+	compareBMPs(
+		stream1, stream2, *tile_width, *tile_height, (out_tile_map) ? *max_tiles : 0,
+		*out_equal, *out_tiles_x, *out_tiles_y, out_tile_map,
 		*out_result);
+	
+	int closeResult1 = closeFile(fptr1);
+	int closeResult2 = closeFile(fptr2);
+	if (closeResult1 || closeResult2)
+		*out_result = CGRESULT_FCLOSE_FAILED;
+}
+
+void graphics_applyLUT8(
+	const int *width, const int *height,
+	const uchar *lut_1, const uchar *lut_2, const uchar *lut_3, const uchar *lut_4,
+	const uchar *in_1, const uchar *in_2, const uchar *in_3, const uchar *in_4,
+	uchar *out_1, uchar *out_2, uchar *out_3, uchar *out_4,
+	int *out_result)
+{
+	if (*width < 0 || *height < 0) {
+		*out_result = CGRESULT_INVALID_ARGUMENT;
+		return;
+	}
+	
+	size_t totalPixels = (size_t)*width * (size_t)*height;
+	LUTKernel kernel = selectLUTKernel();
+	
+	// NOTE: Channels with a null table or buffer are skipped, like in readBMP.
+	const uchar *luts[4] = { lut_1, lut_2, lut_3, lut_4 };
+	const uchar *ins[4] = { in_1, in_2, in_3, in_4 };
+	uchar *outs[4] = { out_1, out_2, out_3, out_4 };
+	LUTChannel channels[4];
+	int channelCount = 0;
+	for (int k = 0; k < 4; k++) {
+		if (luts[k] && ins[k] && outs[k]) {
+			channels[channelCount].lut = luts[k];
+			channels[channelCount].in = ins[k];
+			channels[channelCount].out = outs[k];
+			channelCount++;
+		}
+	}
+	
+	if (channelCount > 0)
+		kernel(channels, channelCount, 0, totalPixels);
+	
+	*out_result = CGRESULT_OK;
 }
 
 void graphics_shutdown(int *out_result) {
-	// NOTE: Nothing to to here at present.
+	#pragma omp critical(cgDecodeCache)
+	{
+		CacheLock lock(defaultDecodeCache);
+		defaultDecodeCache.maxBytes = 0;
+		evictCachedImages(defaultDecodeCache, 0);
+		
+		for (size_t i = 0; i < contextDecodeCaches.size(); i++) {
+			CacheLock contextLock(*contextDecodeCaches[i]);
+			contextDecodeCaches[i]->maxBytes = 0;
+			evictCachedImages(*contextDecodeCaches[i], 0);
+		}
+	}
+	
 	*out_result = CGRESULT_OK;
 }
@@ -60,6 +60,7 @@ enum {
 	CGRESULT_INCOMPLETE_WRITE   = -11,
 	CGRESULT_BAD_DIMENSION      = -12,
 	CGRESULT_FCLOSE_FAILED      = -13,
+	CGRESULT_BUFFER_TOO_SMALL   = -14,
 	
 	CGRESULT_UNSPECIFIED = -1000
 };
@@ -78,16 +79,122 @@ enum {
 	CG_DATA_FORMAT_HCL_BYTES = 4
 };
 
+enum {
+	CG_FLAG_TOP_DOWN = 0x1,
+	CG_FLAG_RLE      = 0x2,
+	CG_FLAG_INDEXED  = 0x4
+};
+
+// NOTE: The stages of the codec and conversion functions timed by the instrumentation. See
+// graphics_getStats.
+enum {
+	CG_STAT_OPEN_CLOSE    = 0,
+	CG_STAT_READ_HEADER   = 1,
+	CG_STAT_READ_BITMAP   = 2,
+	CG_STAT_EXTRACT       = 3,
+	CG_STAT_CONVERT       = 4,
+	CG_STAT_PACK          = 5,
+	CG_STAT_WRITE_HEADER  = 6,
+	CG_STAT_WRITE_BITMAP  = 7,
+	
+	CG_STAT_COUNT = 8
+};
+
+typedef struct cg_context cg_context;
+typedef struct cg_image_reader cg_image_reader;
+typedef struct cg_image_writer cg_image_writer;
+
+enum {
+	CG_METRIC_MSE            = 0,
+	CG_METRIC_PSNR           = 1,
+	CG_METRIC_MAX_ABS_ERROR  = 2,
+	CG_METRIC_MEAN_ABS_ERROR = 3,
+	CG_METRIC_SSIM           = 4,
+	
+	CG_METRIC_COUNT = 5
+};
+
+enum {
+	CG_FILTER_BILINEAR = 1,
+	CG_FILTER_BICUBIC  = 2,
+	CG_FILTER_LANCZOS3 = 3
+};
+
 // NOTE: These functions assume that all channel buffers store values row-by-row, left-to-right
 // and bottom-to-top. That is, the origin of the pixel coordinate system is at the lower left
 // corner of the image and the channel values at coordinates (x,y) in an image of width W is
 // stored at index (x + W*y) in the corresponding channel buffers.
 
+// NOTE: The conversion functions skip null output buffers, and only do the work needed for the
+// requested channels. For example, converting to luma alone is a plain weighted sum.
+
+// NOTE: The BMP readers support uncompressed 24-bit and 32-bit images, and 1-bit, 4-bit and
+// 8-bit indexed-color images, uncompressed or compressed with BI_RLE4 or BI_RLE8. The palette
+// of an indexed-color image is converted once to the requested data format, and its pixels are
+// read with opaque alpha. Pixels skipped by the RLE encoding get the first palette entry.
+// 16-bit and 32-bit images with BI_BITFIELDS masks (such as RGB565) are supported as well, as
+// are the BITMAPV4HEADER and BITMAPV5HEADER headers, whose color space fields are ignored.
+// Masked channels are scaled to 8 bits, and images without an alpha mask are read as opaque.
+
 extern "C" {
 
 CG_GRAPHDLL_DLL_EXPORT
 void graphics_init(int *out_result);
 
+// Enables the decode cache of the calling thread's context (see graphics_createContext), which
+// keeps up to max_bytes of decoded images in memory, or disables it if max_bytes is zero (the
+// default). Call it after graphics_init. While the cache is enabled, whole-file reads
+// (graphics_readImage* and graphics_readImageEx) in the context of an unchanged file in the
+// same data format are served from memory, and the least recently used images are evicted to
+// stay within the budget. A file is identified by its path, size and modification time, and
+// files written through this library are dropped from the caches of all contexts.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_configureDecodeCache(const long long *max_bytes, int *out_result);
+
+// Gets the number of hits and misses of the decode cache of the calling thread's context since
+// it was first enabled, and the number of bytes and images it currently holds.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_getDecodeCacheStats(
+	long long *out_hits, long long *out_misses, long long *out_bytes, int *out_entries,
+	int *out_result);
+
+// Creates a context, which runs the library functions called on the threads it is bound to
+// with its own scratch buffers, statistics and decode cache. The parallel pixel operations
+// (filters, resampling, metrics and integral images) called in the context use at most
+// max_threads threads, or the OpenMP default if max_threads is zero. Each thread has its own
+// pipeline state this way, without contention on shared buffers, counters or caches.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_createContext(const int *max_threads, cg_context **out_context, int *out_result);
+
+// Binds a context to the calling thread, replacing any context bound to it before. All later
+// library calls on the thread run in that context. If context is null, the thread goes back
+// to the default context, which is shared by all threads without a context of their own. A
+// context must not be bound to more than one thread at a time.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_bindContext(cg_context *context, int *out_result);
+
+// Destroys a context, unbinding it from the calling thread. The context must not be bound to
+// any other thread.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_destroyContext(cg_context *context, int *out_result);
+
+// Gets the totals of the instrumented stages in the context of the calling thread, since the
+// context was created or the last call of graphics_resetStats in it. Each output array has
+// CG_STAT_COUNT entries indexed by CG_STAT_*, and null arrays are skipped. For each stage,
+// out_counts gets the number of timed spans (one per file operation, header, chunk or row of
+// the bitmap, or conversion call), out_nanoseconds their total duration on a monotonic clock,
+// and out_bytes and out_pixels the file bytes and pixels they processed. Stages run by
+// concurrent threads overlap, so their time may exceed the wall-clock time. In a library
+// built without instrumentation (the makefile's nostats option), all totals are zero.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_getStats(
+	long long *out_counts, long long *out_nanoseconds, long long *out_bytes,
+	long long *out_pixels,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_resetStats(int *out_result);
+
 CG_GRAPHDLL_DLL_EXPORT
 void graphics_convertRGBtoHCL(
 	const int *width, const int *height, const double *r, const double *g, const double *b,
@@ -160,6 +267,468 @@ void graphics_writeImageBytesHCL(
 	const uchar *h, const uchar *c, const uchar *l, const uchar *a,
 	int *out_result);
 
+// NOTE: The region reading functions below read the region of width x height pixels whose lower
+// left corner is at (x,y) in the image, and store it in the channel buffers as an image of
+// that size. Only the rows and columns of the region are read from the file. A region that
+// does not fit inside the image yields CGRESULT_BAD_DIMENSION.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageRegionRGB(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	double *out_r, double *out_g, double *out_b, double *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageRegionHCL(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	double *out_h, double *out_c, double *out_l, double *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageRegionBytesRGB(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	uchar *out_r, uchar *out_g, uchar *out_b, uchar *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageRegionBytesHCL(
+	const char *file_name, const char *file_type,
+	const int *x, const int *y, const int *width, const int *height,
+	uchar *out_h, uchar *out_c, uchar *out_l, uchar *out_a,
+	int *out_result);
+
+// NOTE: The decimating read functions below read an image scaled down by an integer factor
+// of 1, 2, 4 or 8, averaging each block of factor x factor pixels as the file is decoded. The
+// output image has a size of ceil(W/factor) x ceil(H/factor), which is checked against the
+// maximum width and height.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageDecimatedRGB(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	double *out_r, double *out_g, double *out_b, double *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageDecimatedHCL(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	double *out_h, double *out_c, double *out_l, double *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageDecimatedBytesRGB(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	uchar *out_r, uchar *out_g, uchar *out_b, uchar *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageDecimatedBytesHCL(
+	const char *file_name, const char *file_type, const int *factor,
+	const int *max_width, const int *max_height, int *out_width, int *out_height,
+	uchar *out_h, uchar *out_c, uchar *out_l, uchar *out_a,
+	int *out_result);
+
+// NOTE: The Ex functions below work like the functions above, but on channel buffers whose
+// rows are row_stride elements apart, so that crops, tiles and padded rows of larger buffers
+// can be used directly. The pixel (x, y) is at index x + row_stride*y. A stride of zero means
+// tightly packed rows, and any other stride must be at least the width of the image or region.
+// The read and write functions take the data format (CG_DATA_FORMAT_*) as an argument, and the
+// channel buffers in the order of the corresponding functions above. With CG_FLAG_TOP_DOWN in
+// flags, the channel buffers store rows top-to-bottom instead, i.e. the origin is at the upper
+// left corner, and region coordinates are counted from there. The rows are placed in that
+// order as they are decoded or encoded, without a separate flip.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_convertRGBtoHCLEx(
+	const int *width, const int *height,
+	const int *in_stride, const double *r, const double *g, const double *b,
+	const int *out_stride, double *out_h, double *out_c, double *out_l,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_convertHCLtoRGBEx(
+	const int *width, const int *height,
+	const int *in_stride, const double *h, const double *c, const double *l,
+	const int *out_stride, double *out_r, double *out_g, double *out_b,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_convertBytesRGBtoHCLEx(
+	const int *width, const int *height,
+	const int *in_stride, const uchar *r, const uchar *g, const uchar *b,
+	const int *out_stride, uchar *out_h, uchar *out_c, uchar *out_l,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_convertBytesHCLtoRGBEx(
+	const int *width, const int *height,
+	const int *in_stride, const uchar *h, const uchar *c, const uchar *l,
+	const int *out_stride, uchar *out_r, uchar *out_g, uchar *out_b,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageEx(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *max_width, const int *max_height, const int *row_stride, const int *flags,
+	int *out_width, int *out_height, void *out_1, void *out_2, void *out_3, void *out_4,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageRegionEx(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *x, const int *y, const int *width, const int *height,
+	const int *row_stride, const int *flags,
+	void *out_1, void *out_2, void *out_3, void *out_4,
+	int *out_result);
+
+// NOTE: With CG_FLAG_INDEXED in flags, graphics_writeImageEx and graphics_writeImageFd write
+// an indexed-color image instead, with a palette of at most 256 colors chosen for the image,
+// written like graphics_writeIndexedImage does, so that CG_FLAG_RLE selects BI_RLE8. The
+// alpha channel is not written. The encode functions do not support CG_FLAG_INDEXED, and fail
+// with CGRESULT_INVALID_ARGUMENT.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_writeImageEx(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const void *in_1, const void *in_2, const void *in_3, const void *in_4,
+	int *out_result);
+
+// Writes an indexed-color image, whose pixels are indices into a palette of palette_size colors
+// (at most 256), given as the byte channels palette_r, palette_g and palette_b. The indices are
+// laid out like a byte channel of graphics_writeImageEx, and an index outside the palette fails
+// with CGRESULT_INVALID_ARGUMENT before anything is written. The bitmap is written with 1, 4 or
+// 8 bits per pixel, the fewest that hold the palette, or compressed with BI_RLE8 if flags has
+// CG_FLAG_RLE.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_writeIndexedImage(
+	const char *file_name, const char *file_type,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const uchar *indices, const int *palette_size,
+	const uchar *palette_r, const uchar *palette_g, const uchar *palette_b,
+	int *out_result);
+
+// NOTE: The decode and encode functions below work like the read and write functions above,
+// but on BMP data in memory instead of files. Decoding extracts the pixels directly from the
+// data buffer, which holds size bytes; the format is recognized from the data itself. Encoding
+// writes the image in the format given by file_type (e.g. "bmp") to out_data, which has room
+// for capacity bytes, and out_size receives the size of the encoded image. If the image does
+// not fit, nothing is written and the result is CGRESULT_BUFFER_TOO_SMALL.
+// graphics_getEncodedImageSize gives the size of an encoded image up front, so that the output
+// buffer can be allocated once.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_decodeImageRGB(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, double *out_r, double *out_g, double *out_b, double *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_encodeImageRGB(
+	const char *file_type, const int *width, const int *height,
+	const double *r, const double *g, const double *b, const double *a,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_decodeImageHCL(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, double *out_h, double *out_c, double *out_l, double *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_encodeImageHCL(
+	const char *file_type, const int *width, const int *height,
+	const double *h, const double *c, const double *l, const double *a,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_decodeImageBytesRGB(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, uchar *out_r, uchar *out_g, uchar *out_b, uchar *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_encodeImageBytesRGB(
+	const char *file_type, const int *width, const int *height,
+	const uchar *r, const uchar *g, const uchar *b, const uchar *a,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_decodeImageBytesHCL(
+	const void *data, const long long *size, const int *max_width, const int *max_height,
+	int *out_width, int *out_height, uchar *out_h, uchar *out_c, uchar *out_l, uchar *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_encodeImageBytesHCL(
+	const char *file_type, const int *width, const int *height,
+	const uchar *h, const uchar *c, const uchar *l, const uchar *a,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_decodeImageEx(
+	const void *data, const long long *size, const int *data_format,
+	const int *max_width, const int *max_height, const int *row_stride, const int *flags,
+	int *out_width, int *out_height, void *out_1, void *out_2, void *out_3, void *out_4,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_encodeImageEx(
+	const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const void *in_1, const void *in_2, const void *in_3, const void *in_4,
+	void *out_data, const long long *capacity, long long *out_size,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_getEncodedImageSize(
+	const char *file_type, const int *width, const int *height, const int *with_alpha,
+	long long *out_size,
+	int *out_result);
+
+// NOTE: The descriptor functions below work like graphics_readImageEx and graphics_writeImageEx,
+// but on an open file descriptor, e.g. 0 for standard input or 1 for standard output. They
+// start at the current position of the descriptor and consume only the bytes of one image, so
+// several images can be streamed through one pipe. Descriptors that cannot seek, like pipes,
+// are supported. The descriptor is not closed, and must be in binary mode on Windows.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageFd(
+	const int *fd, const int *data_format,
+	const int *max_width, const int *max_height, const int *row_stride, const int *flags,
+	int *out_width, int *out_height, void *out_1, void *out_2, void *out_3, void *out_4,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_writeImageFd(
+	const int *fd, const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *row_stride, const int *flags,
+	const void *in_1, const void *in_2, const void *in_3, const void *in_4,
+	int *out_result);
+
+// NOTE: The row streaming functions below read and write images a few rows at a time, so
+// that only the rows in flight need to be buffered. The channel buffers passed to them are of
+// the type selected by the data format (CG_DATA_FORMAT_*), i.e. double or uchar, and receive
+// or supply row_count rows of the image width each. Rows are streamed bottom-to-top, in the
+// order of the channel buffer layout described above. An opened reader or writer must be
+// closed even if a row access fails. Closing a writer before all rows have been written yields
+// CGRESULT_INCOMPLETE_WRITE.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_openImageReader(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *max_width, const int *max_height,
+	cg_image_reader **out_reader, int *out_width, int *out_height,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_readImageRows(
+	cg_image_reader *reader, const int *row_count,
+	void *out_r, void *out_g, void *out_b, void *out_a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_closeImageReader(cg_image_reader *reader, int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_openImageWriter(
+	const char *file_name, const char *file_type, const int *data_format,
+	const int *width, const int *height, const int *with_alpha,
+	cg_image_writer **out_writer,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_writeImageRows(
+	cg_image_writer *writer, const int *row_count,
+	const void *r, const void *g, const void *b, const void *a,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_closeImageWriter(cg_image_writer *writer, int *out_result);
+
+// Checks whether the pixels of two image files are identical. Bitmaps stored in the same way
+// (row order, pixel format and bit field masks) are compared byte by byte without decoding
+// them, ignoring the row padding. Other bitmaps, including all indexed-color ones, are decoded
+// to RGBA bytes a band of rows at a time and compared by value. The images are split into
+// tiles of tile_width x tile_height pixels, counted from the lower left corner, and
+// out_tiles_x and out_tiles_y receive the number of tiles in each direction. If out_tile_map
+// is null, the comparison stops at the first difference. Otherwise, it must hold at least
+// max_tiles bytes, and receives one byte per tile (1 if changed, 0 if not), indexed by
+// (tx + tiles_x*ty). Images of different sizes are unequal and have no tiles.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_compareImageFiles(
+	const char *file_name_1, const char *file_name_2, const char *file_type,
+	const int *tile_width, const int *tile_height, const int *max_tiles,
+	int *out_equal, int *out_tiles_x, int *out_tiles_y, uchar *out_tile_map,
+	int *out_result);
+
+// Builds an image pyramid from an image file, reading the file once. Each level halves the
+// width and height of the one above it (rounding up), averaging 2 x 2 pixel blocks, down to a
+// size of 1 x 1 pixels or max_levels levels, whichever comes first. Level k (from 1) is written
+// to the file <out_file_base>_<k>.<out_file_type>, with an alpha channel if with_alpha is
+// non-zero. An empty out_file_type means "bmp". Only a few rows per level are held in memory.
+// out_levels receives the number of levels written.
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_buildImagePyramid(
+	const char *file_name, const char *file_type,
+	const char *out_file_base, const char *out_file_type,
+	const int *max_levels, const int *with_alpha,
+	int *out_levels,
+	int *out_result);
+
+// Maps the values in up to four byte channel buffers through 256-entry lookup tables, that is
+// out_k[i] = lut_k[in_k[i]]. A channel is skipped if its table or either of its buffers is null.
+// An output buffer may be the same as the corresponding input buffer (in-place operation).
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_applyLUT8(
+	const int *width, const int *height,
+	const uchar *lut_1, const uchar *lut_2, const uchar *lut_3, const uchar *lut_4,
+	const uchar *in_1, const uchar *in_2, const uchar *in_3, const uchar *in_4,
+	uchar *out_1, uchar *out_2, uchar *out_3, uchar *out_4,
+	int *out_result);
+
+// NOTE: The difference measurement functions below compare two channel buffers of the same
+// size and store CG_METRIC_COUNT values in out_metrics, indexed by CG_METRIC_*. The error
+// metrics are in channel units, and the PSNR is relative to a peak value of 1.0 for double
+// and float channels and 255 for byte channels. It is infinite for identical channels. The
+// SSIM is the mean over all positions of a uniform window of ssim_window x ssim_window pixels
+// (clamped to the image size). It is not computed, and reported as 0, if ssim_window is 0.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_measureDifference(
+	const int *width, const int *height, const double *p1, const double *p2,
+	const int *ssim_window, double *out_metrics,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_measureDifferenceFloat(
+	const int *width, const int *height, const float *p1, const float *p2,
+	const int *ssim_window, double *out_metrics,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_measureDifferenceBytes(
+	const int *width, const int *height, const uchar *p1, const uchar *p2,
+	const int *ssim_window, double *out_metrics,
+	int *out_result);
+
+// NOTE: The resampling functions below scale a channel buffer to a new size with a separable
+// filter (CG_FILTER_*). The filter is widened when scaling down, so that it also acts as an
+// anti-aliasing filter, and the image edges are extended by repeating the edge pixels. The
+// source and destination buffers must not overlap.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_resample(
+	const int *src_width, const int *src_height, const double *src,
+	const int *dst_width, const int *dst_height, double *dst,
+	const int *filter,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_resampleFloat(
+	const int *src_width, const int *src_height, const float *src,
+	const int *dst_width, const int *dst_height, float *dst,
+	const int *filter,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_resampleBytes(
+	const int *src_width, const int *src_height, const uchar *src,
+	const int *dst_width, const int *dst_height, uchar *dst,
+	const int *filter,
+	int *out_result);
+
+// NOTE: The filter functions below work in place on a channel buffer, one direction at a time,
+// and extend the image edges by repeating the edge pixels. Byte channels are rounded back to
+// bytes after each direction.
+// graphics_convolve* applies a separable convolution. kernel_x and kernel_y hold 2*radius + 1
+// weights each, centered on the filtered pixel; a null kernel skips that direction.
+// graphics_boxBlur* averages over a (2*radius_x + 1) x (2*radius_y + 1) window, and
+// graphics_gaussianBlur* applies a recursive approximation of a Gaussian filter. Their cost
+// does not depend on the radius or sigma. A zero radius or sigma skips that direction. Sigmas
+// below 0.5 are applied as a sampled 3-pixel Gaussian kernel instead.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_convolve(
+	const int *width, const int *height, double *pixels,
+	const double *kernel_x, const int *radius_x,
+	const double *kernel_y, const int *radius_y,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_convolveBytes(
+	const int *width, const int *height, uchar *pixels,
+	const double *kernel_x, const int *radius_x,
+	const double *kernel_y, const int *radius_y,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_boxBlur(
+	const int *width, const int *height, double *pixels,
+	const int *radius_x, const int *radius_y,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_boxBlurBytes(
+	const int *width, const int *height, uchar *pixels,
+	const int *radius_x, const int *radius_y,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_gaussianBlur(
+	const int *width, const int *height, double *pixels,
+	const double *sigma_x, const double *sigma_y,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_gaussianBlurBytes(
+	const int *width, const int *height, uchar *pixels,
+	const double *sigma_x, const double *sigma_y,
+	int *out_result);
+
+// NOTE: The integral image functions below build summed-area tables for a channel buffer.
+// A table has (width + 1) x (height + 1) entries, indexed like a channel buffer of that size;
+// the entry at (x, y) is the sum over all pixels left of x and below y. out_squares, if not
+// null, receives the same table for the squared pixel values. Byte channels use exact 64-bit
+// integer tables.
+// The query functions compute the sums, means and variances of rect_count rectangles in
+// constant time each. rects holds an x, y, width, height quadruple per rectangle, and each
+// non-null output array receives one value per rectangle. Variances need the squares table.
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_buildIntegralImage(
+	const int *width, const int *height, const double *pixels,
+	double *out_sums, double *out_squares,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_buildIntegralImageBytes(
+	const int *width, const int *height, const uchar *pixels,
+	long long *out_sums, long long *out_squares,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_queryIntegralImage(
+	const int *width, const int *height, const double *sums, const double *squares,
+	const int *rect_count, const int *rects,
+	double *out_sums, double *out_means, double *out_variances,
+	int *out_result);
+
+CG_GRAPHDLL_DLL_EXPORT
+void graphics_queryIntegralImageBytes(
+	const int *width, const int *height, const long long *sums, const long long *squares,
+	const int *rect_count, const int *rects,
+	double *out_sums, double *out_means, double *out_variances,
+	int *out_result);
+
 CG_GRAPHDLL_DLL_EXPORT
 void graphics_shutdown(int *out_result);
 
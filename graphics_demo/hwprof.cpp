@@ -0,0 +1,530 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "graphdll.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// NOTE: This program runs the graphdll kernels under groups of hardware performance counters
+// (cycles, instructions, branch misses, last level cache misses and front-end stall cycles)
+// read with perf_event_open, on a standard set of synthetic images, and prints one CSV line
+// per kernel and image:
+//
+//   kernel,image,bits,width,height,cycles_per_pixel,instructions_per_pixel,ipc,
+//   branch_misses_per_kpixel,llc_misses_per_kpixel,frontend_stall_ratio
+//
+// The counts are taken from the run with the fewest cycles, in user mode only, on the calling
+// thread, so the kernels should be profiled with a single OpenMP thread (OMP_NUM_THREADS=1,
+// as the makefile's hwprof target does). Counters that the CPU does not support are reported
+// as nan. Linux only.
+//
+// Usage: hwprof [size]
+
+#ifdef __linux__
+
+namespace { // begin anonymous namespace
+
+const int DEFAULT_SIZE = 1024;
+const int RUNS = 5;
+
+// Counter Groups
+
+enum {
+	COUNTER_CYCLES = 0,
+	COUNTER_INSTRUCTIONS,
+	COUNTER_BRANCH_MISSES,
+	COUNTER_LLC_MISSES,
+	COUNTER_FRONTEND_STALLS,
+	
+	COUNTER_COUNT
+};
+
+const unsigned long long COUNTER_CONFIGS[COUNTER_COUNT] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_STALLED_CYCLES_FRONTEND
+};
+
+// NOTE: The cycle counter leads the group, so all counters are scheduled together. The other
+// counters are optional; fds[i] is -1 for those that could not be opened.
+struct CounterGroup {
+	int fds[COUNTER_COUNT];
+	int slots[COUNTER_COUNT]; // Position of each counter in the group read.
+	int opened;
+};
+
+int openCounter(unsigned long long config, int groupFd) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = (groupFd == -1) ? 1 : 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format =
+		PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+bool openCounterGroup(CounterGroup &group) {
+	group.opened = 0;
+	
+	for (int i = 0; i < COUNTER_COUNT; i++) {
+		int leader = (i == 0) ? -1 : group.fds[0];
+		group.fds[i] = openCounter(COUNTER_CONFIGS[i], leader);
+		group.slots[i] = (group.fds[i] >= 0) ? group.opened++ : -1;
+		
+		if (i == 0 && group.fds[0] < 0)
+			return false;
+	}
+	
+	return true;
+}
+
+void closeCounterGroup(CounterGroup &group) {
+	for (int i = COUNTER_COUNT - 1; i >= 0; i--) {
+		if (group.fds[i] >= 0)
+			close(group.fds[i]);
+	}
+}
+
+// NOTE: If the group was multiplexed with other events, the counts are scaled up to the time
+// the group was enabled. Missing counters read as -1.
+bool readCounterGroup(const CounterGroup &group, double *values) {
+	unsigned long long data[3 + COUNTER_COUNT];
+	ssize_t size = (3 + group.opened) * sizeof(unsigned long long);
+	
+	if (read(group.fds[0], data, size) != size)
+		return false;
+	
+	double scale = (data[2] > 0) ? (double)data[1] / (double)data[2] : 0.0;
+	
+	for (int i = 0; i < COUNTER_COUNT; i++)
+		values[i] = (group.slots[i] >= 0) ? scale * (double)data[3 + group.slots[i]] : -1.0;
+	
+	return true;
+}
+
+// Profiling State
+// NOTE: The planes hold one image of the standard set, in each data format, with its BMP
+// encodings in memory. Outputs go to the scratch planes.
+struct Profile {
+	int width, height;
+	size_t size;
+	int bits;
+	
+	std::vector<double> r, g, b, a, h, c, l, out1, out2, out3, out4;
+	std::vector<uchar> br, bg, bb, ba, bh, bc, bl, bout1, bout2, bout3, bout4;
+	std::vector<char> encoded24, encoded32;
+	std::vector<uchar> lut;
+	int result;
+	
+	const std::vector<char> &encoded() const { return (bits == 32) ? encoded32 : encoded24; }
+	const double *alpha() const { return (bits == 32) ? &a[0] : 0; }
+	const uchar *bytesAlpha() const { return (bits == 32) ? &ba[0] : 0; }
+	double *outAlpha() { return (bits == 32) ? &out4[0] : 0; }
+	uchar *bytesOutAlpha() { return (bits == 32) ? &bout4[0] : 0; }
+};
+
+// Standard Images
+// NOTE: The gradient is the smooth test pattern of the old cgtest code, where the hue sextant
+// branches are well predicted. The noise image has random pixels, where they are not. The
+// gray image has no chroma at all.
+enum { IMAGE_GRADIENT, IMAGE_NOISE, IMAGE_GRAY, IMAGE_COUNT };
+
+const char *const IMAGE_NAMES[IMAGE_COUNT] = { "gradient", "noise", "gray" };
+
+int generateImage(Profile &profile, int image, int width, int height) {
+	profile.width = width;
+	profile.height = height;
+	profile.size = (size_t)width * height;
+	
+	size_t size = profile.size;
+	profile.r.resize(size); profile.g.resize(size); profile.b.resize(size);
+	profile.a.resize(size);
+	profile.h.resize(size); profile.c.resize(size); profile.l.resize(size);
+	profile.out1.resize(size); profile.out2.resize(size);
+	profile.out3.resize(size); profile.out4.resize(size);
+	profile.br.resize(size); profile.bg.resize(size); profile.bb.resize(size);
+	profile.ba.resize(size);
+	profile.bh.resize(size); profile.bc.resize(size); profile.bl.resize(size);
+	profile.bout1.resize(size); profile.bout2.resize(size);
+	profile.bout3.resize(size); profile.bout4.resize(size);
+	
+	double diagE = std::sqrt((double)width*width + (double)height*height);
+	double diagM = (double)(width + height);
+	unsigned int seed = 12345;
+	
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t i = x + (size_t)width*y;
+			unsigned int rv, gv, bv;
+			
+			if (image == IMAGE_GRADIENT) {
+				rv = (unsigned int)(255.0*std::sqrt((double)x*x + (double)y*y)/diagE + 0.5);
+				gv = (unsigned int)(255.0*((width - x) + y)/diagM + 0.5);
+				bv = (unsigned int)(255.0*(x + (height - y))/diagM + 0.5);
+			}
+			else if (image == IMAGE_NOISE) {
+				seed = seed*1103515245u + 12345u;
+				rv = (seed >> 8) & 0xff;
+				gv = (seed >> 16) & 0xff;
+				seed = seed*1103515245u + 12345u;
+				bv = (seed >> 8) & 0xff;
+			}
+			else {
+				rv = gv = bv = (unsigned int)((x + y) & 0xff);
+			}
+			
+			profile.br[i] = (uchar)rv;
+			profile.bg[i] = (uchar)gv;
+			profile.bb[i] = (uchar)bv;
+			profile.ba[i] = (uchar)((x ^ y) & 0xff);
+			profile.r[i] = rv/255.0;
+			profile.g[i] = gv/255.0;
+			profile.b[i] = bv/255.0;
+			profile.a[i] = profile.ba[i]/255.0;
+		}
+	}
+	
+	int res;
+	graphics_convertRGBtoHCL(
+		&width, &height, &profile.r[0], &profile.g[0], &profile.b[0],
+		&profile.h[0], &profile.c[0], &profile.l[0], &res);
+	graphics_convertBytesRGBtoHCL(
+		&width, &height, &profile.br[0], &profile.bg[0], &profile.bb[0],
+		&profile.bh[0], &profile.bc[0], &profile.bl[0], &res);
+	
+	for (int withAlpha = 0; withAlpha <= 1; withAlpha++) {
+		std::vector<char> &encoded = (withAlpha) ? profile.encoded32 : profile.encoded24;
+		long long capacity, size;
+		
+		graphics_getEncodedImageSize("bmp", &width, &height, &withAlpha, &capacity, &res);
+		if (res != CGRESULT_OK)
+			return res;
+		
+		encoded.resize((size_t)capacity);
+		graphics_encodeImageBytesRGB(
+			"bmp", &width, &height, &profile.br[0], &profile.bg[0], &profile.bb[0],
+			(withAlpha) ? &profile.ba[0] : 0, &encoded[0], &capacity, &size, &res);
+		if (res != CGRESULT_OK)
+			return res;
+	}
+	
+	profile.lut.resize(256);
+	for (int i = 0; i < 256; i++)
+		profile.lut[i] = (uchar)(255 - i);
+	
+	return CGRESULT_OK;
+}
+
+// Kernels
+// NOTE: The codec kernels decode from and encode to memory, so that the counts cover the
+// extractors and packers without any file I/O.
+
+typedef void (*KernelFunction)(Profile &profile);
+
+void convertRGBtoHCL(Profile &p) {
+	graphics_convertRGBtoHCL(
+		&p.width, &p.height, &p.r[0], &p.g[0], &p.b[0],
+		&p.out1[0], &p.out2[0], &p.out3[0], &p.result);
+}
+
+void convertRGBtoLuma(Profile &p) {
+	graphics_convertRGBtoHCL(
+		&p.width, &p.height, &p.r[0], &p.g[0], &p.b[0], 0, 0, &p.out3[0], &p.result);
+}
+
+void convertHCLtoRGB(Profile &p) {
+	graphics_convertHCLtoRGB(
+		&p.width, &p.height, &p.h[0], &p.c[0], &p.l[0],
+		&p.out1[0], &p.out2[0], &p.out3[0], &p.result);
+}
+
+void convertBytesRGBtoHCL(Profile &p) {
+	graphics_convertBytesRGBtoHCL(
+		&p.width, &p.height, &p.br[0], &p.bg[0], &p.bb[0],
+		&p.bout1[0], &p.bout2[0], &p.bout3[0], &p.result);
+}
+
+void convertBytesHCLtoRGB(Profile &p) {
+	graphics_convertBytesHCLtoRGB(
+		&p.width, &p.height, &p.bh[0], &p.bc[0], &p.bl[0],
+		&p.bout1[0], &p.bout2[0], &p.bout3[0], &p.result);
+}
+
+void decodeImageRGB(Profile &p) {
+	long long size = (long long)p.encoded().size();
+	int w, h;
+	graphics_decodeImageRGB(
+		&p.encoded()[0], &size, &p.width, &p.height, &w, &h,
+		&p.out1[0], &p.out2[0], &p.out3[0], p.outAlpha(), &p.result);
+}
+
+void decodeImageHCL(Profile &p) {
+	long long size = (long long)p.encoded().size();
+	int w, h;
+	graphics_decodeImageHCL(
+		&p.encoded()[0], &size, &p.width, &p.height, &w, &h,
+		&p.out1[0], &p.out2[0], &p.out3[0], p.outAlpha(), &p.result);
+}
+
+void decodeImageBytesRGB(Profile &p) {
+	long long size = (long long)p.encoded().size();
+	int w, h;
+	graphics_decodeImageBytesRGB(
+		&p.encoded()[0], &size, &p.width, &p.height, &w, &h,
+		&p.bout1[0], &p.bout2[0], &p.bout3[0], p.bytesOutAlpha(), &p.result);
+}
+
+void decodeImageBytesHCL(Profile &p) {
+	long long size = (long long)p.encoded().size();
+	int w, h;
+	graphics_decodeImageBytesHCL(
+		&p.encoded()[0], &size, &p.width, &p.height, &w, &h,
+		&p.bout1[0], &p.bout2[0], &p.bout3[0], p.bytesOutAlpha(), &p.result);
+}
+
+// NOTE: The encoders write over the scratch output planes, which are as large as any encoding
+// of the image.
+void encodeImageRGB(Profile &p) {
+	long long capacity = (long long)(p.size * sizeof(double)), size;
+	graphics_encodeImageRGB(
+		"bmp", &p.width, &p.height, &p.r[0], &p.g[0], &p.b[0], p.alpha(),
+		&p.out1[0], &capacity, &size, &p.result);
+}
+
+void encodeImageHCL(Profile &p) {
+	long long capacity = (long long)(p.size * sizeof(double)), size;
+	graphics_encodeImageHCL(
+		"bmp", &p.width, &p.height, &p.h[0], &p.c[0], &p.l[0], p.alpha(),
+		&p.out1[0], &capacity, &size, &p.result);
+}
+
+void encodeImageBytesRGB(Profile &p) {
+	long long capacity = (long long)(p.size * sizeof(double)), size;
+	graphics_encodeImageBytesRGB(
+		"bmp", &p.width, &p.height, &p.br[0], &p.bg[0], &p.bb[0], p.bytesAlpha(),
+		&p.out1[0], &capacity, &size, &p.result);
+}
+
+void encodeImageBytesHCL(Profile &p) {
+	long long capacity = (long long)(p.size * sizeof(double)), size;
+	graphics_encodeImageBytesHCL(
+		"bmp", &p.width, &p.height, &p.bh[0], &p.bc[0], &p.bl[0], p.bytesAlpha(),
+		&p.out1[0], &capacity, &size, &p.result);
+}
+
+void applyLUT8(Profile &p) {
+	const uchar *lut = &p.lut[0];
+	graphics_applyLUT8(
+		&p.width, &p.height, lut, lut, lut, 0, &p.br[0], &p.bg[0], &p.bb[0], 0,
+		&p.bout1[0], &p.bout2[0], &p.bout3[0], 0, &p.result);
+}
+
+void resampleBytes(Profile &p) {
+	int dstWidth = p.width/2, dstHeight = p.height/2, filter = CG_FILTER_LANCZOS3;
+	graphics_resampleBytes(
+		&p.width, &p.height, &p.br[0], &dstWidth, &dstHeight, &p.bout1[0], &filter, &p.result);
+}
+
+void gaussianBlurBytes(Profile &p) {
+	double sigma = 4.0;
+	std::memcpy(&p.bout1[0], &p.br[0], p.size);
+	graphics_gaussianBlurBytes(&p.width, &p.height, &p.bout1[0], &sigma, &sigma, &p.result);
+}
+
+void measureDifference(Profile &p) {
+	int window = 8;
+	double metrics[CG_METRIC_COUNT];
+	graphics_measureDifference(
+		&p.width, &p.height, &p.r[0], &p.g[0], &window, metrics, &p.result);
+}
+
+struct Kernel {
+	const char *name;
+	bool perDepth; // Run once per BMP bit depth.
+	KernelFunction run;
+};
+
+const Kernel KERNELS[] = {
+	{ "convertRGBtoHCL", false, convertRGBtoHCL },
+	{ "convertRGBtoHCL/luma", false, convertRGBtoLuma },
+	{ "convertHCLtoRGB", false, convertHCLtoRGB },
+	{ "convertBytesRGBtoHCL", false, convertBytesRGBtoHCL },
+	{ "convertBytesHCLtoRGB", false, convertBytesHCLtoRGB },
+	{ "decodeImageRGB", true, decodeImageRGB },
+	{ "decodeImageHCL", true, decodeImageHCL },
+	{ "decodeImageBytesRGB", true, decodeImageBytesRGB },
+	{ "decodeImageBytesHCL", true, decodeImageBytesHCL },
+	{ "encodeImageRGB", true, encodeImageRGB },
+	{ "encodeImageHCL", true, encodeImageHCL },
+	{ "encodeImageBytesRGB", true, encodeImageBytesRGB },
+	{ "encodeImageBytesHCL", true, encodeImageBytesHCL },
+	{ "applyLUT8", false, applyLUT8 },
+	{ "resampleBytes", false, resampleBytes },
+	{ "gaussianBlurBytes", false, gaussianBlurBytes },
+	{ "measureDifference", false, measureDifference }
+};
+
+const int KERNEL_COUNT = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+void printRatio(double numerator, double denominator, double scale) {
+	if (numerator < 0.0 || denominator <= 0.0)
+		std::printf(",nan");
+	else
+		std::printf(",%.4f", scale * numerator / denominator);
+}
+
+// Runs a kernel RUNS times after one warm-up run and prints the counts of the run with the
+// fewest cycles.
+int profileKernel(Profile &profile, CounterGroup &group, const Kernel &kernel, int image) {
+	double best[COUNTER_COUNT], values[COUNTER_COUNT];
+	
+	profile.result = CGRESULT_OK;
+	kernel.run(profile);
+	if (profile.result != CGRESULT_OK)
+		return profile.result;
+	
+	for (int i = 0; i < COUNTER_COUNT; i++)
+		best[i] = -1.0;
+	
+	for (int run = 0; run < RUNS; run++) {
+		ioctl(group.fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(group.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		kernel.run(profile);
+		ioctl(group.fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		
+		if (!readCounterGroup(group, values))
+			return CGRESULT_READ_ERROR;
+		
+		if (best[COUNTER_CYCLES] < 0.0 || values[COUNTER_CYCLES] < best[COUNTER_CYCLES])
+			std::memcpy(best, values, sizeof(best));
+	}
+	
+	double pixels = (double)profile.size;
+	std::printf(
+		"%s,%s,%d,%d,%d", kernel.name, IMAGE_NAMES[image],
+		(kernel.perDepth) ? profile.bits : 0, profile.width, profile.height);
+	printRatio(best[COUNTER_CYCLES], pixels, 1.0);
+	printRatio(best[COUNTER_INSTRUCTIONS], pixels, 1.0);
+	printRatio(best[COUNTER_INSTRUCTIONS], best[COUNTER_CYCLES], 1.0);
+	printRatio(best[COUNTER_BRANCH_MISSES], pixels, 1000.0);
+	printRatio(best[COUNTER_LLC_MISSES], pixels, 1000.0);
+	printRatio(best[COUNTER_FRONTEND_STALLS], best[COUNTER_CYCLES], 1.0);
+	std::printf("\n");
+	std::fflush(stdout);
+	
+	return CGRESULT_OK;
+}
+
+} // end anonymous namespace
+
+int main(int argc, const char **argv) {
+	int size = (argc > 1) ? std::atoi(argv[1]) : DEFAULT_SIZE;
+	int res, failures = 0;
+	
+	if (size < 8) {
+		std::fprintf(stderr, "hwprof: invalid image size '%s'\n", argv[1]);
+		return 1;
+	}
+	
+	CounterGroup group;
+	if (!openCounterGroup(group)) {
+		std::fprintf(
+			stderr, "hwprof: cannot open the cycle counter (%s). Check "
+			"/proc/sys/kernel/perf_event_paranoid.\n", std::strerror(errno));
+		return 1;
+	}
+	
+	graphics_init(&res);
+	
+	std::printf(
+		"kernel,image,bits,width,height,cycles_per_pixel,instructions_per_pixel,ipc,"
+		"branch_misses_per_kpixel,llc_misses_per_kpixel,frontend_stall_ratio\n");
+	
+	Profile profile;
+	
+	for (int image = 0; image < IMAGE_COUNT; image++) {
+		res = generateImage(profile, image, size, size);
+		if (res != CGRESULT_OK) {
+			std::fprintf(stderr, "hwprof: could not generate images (result %d)\n", res);
+			failures++;
+			continue;
+		}
+		
+		for (int k = 0; k < KERNEL_COUNT; k++) {
+			const Kernel &kernel = KERNELS[k];
+			
+			for (int bits = 24; bits <= 32; bits += 8) {
+				profile.bits = bits;
+				if (!kernel.perDepth && bits != 24)
+					continue;
+				
+				res = profileKernel(profile, group, kernel, image);
+				if (res != CGRESULT_OK) {
+					std::fprintf(
+						stderr, "hwprof: %s (%s, %d bits) failed with result %d\n",
+						kernel.name, IMAGE_NAMES[image], bits, res);
+					failures++;
+				}
+			}
+		}
+	}
+	
+	closeCounterGroup(group);
+	graphics_shutdown(&res);
+	return (failures == 0) ? 0 : 1;
+}
+
+#else
+
+int main(int argc, const char **argv) {
+	std::fprintf(stderr, "hwprof: hardware counters are only supported on Linux\n");
+	return 1;
+}
+
+#endif
@@ -30,13 +30,22 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <cmath>
+#include <cstring>
 #include "graphdll.hpp"
 #include "imgdiff.hpp"
 
 namespace {
 
+// NOTE: The tiles are DIFF_TILE_WIDTH pixels wide and one band of rows high.
+const int DIFF_ROWS_PER_BAND = 16;
+const int DIFF_TILE_WIDTH = 64;
+
 const double SQRT3 = std::sqrt(3.0);
 
+const float LUMA_COEFF_R = 0.2126f;
+const float LUMA_COEFF_G = 0.7152f;
+const float LUMA_COEFF_B = 0.0722f;
+
 double pixelDistance(double r1, double g1, double b1, double r2, double g2, double b2) {
 	double dr = r2 - r1;
 	double dg = g2 - g1;
@@ -44,32 +53,17 @@ double pixelDistance(double r1, double g1, double b1, double r2, double g2, doub
 	return std::sqrt(dr*dr + dg*dg + db*db) / SQRT3;
 }
 
-}
-
-int imageDiff(
+void diffPixels(
 	int nPixels,
 	const double *i1_r, const double *i1_g, const double *i1_b,
 	const double *i2_r, const double *i2_g, const double *i2_b,
+	double *i1_l, const double *i2_l,
 	double *o_r, double *o_g, double *o_b)
 {
-	int height = 1, res = -9999;
-	//double *i1_h = new double[nPixels];
-	//double *i1_c = new double[nPixels];
-	double *i1_l = new double[nPixels];
-	//double *i2_h = new double[nPixels];
-	//double *i2_c = new double[nPixels];
-	double *i2_l = new double[nPixels];
-	//graphics_convertRGBtoHCL(&nPixels, &height, i1_r, i1_g, i1_b, i1_h, i1_c, i1_l, &res);
-	//graphics_convertRGBtoHCL(&nPixels, &height, i2_r, i2_g, i2_b, i2_h, i2_c, i2_l, &res);
-	graphics_convertRGBtoHCL(&nPixels, &height, i1_r, i1_g, i1_b, i1_l, i1_l, i1_l, &res);
-	graphics_convertRGBtoHCL(&nPixels, &height, i2_r, i2_g, i2_b, i2_l, i2_l, i2_l, &res);
-	
 	for (int k = 0; k < nPixels; k++) {
 		o_r[k] = i2_l[k];
 		o_g[k] = i1_l[k];
 		
-		//i1_h[k] = 0.0;
-		//i1_c[k] = 0.0;
 		i1_l[k] = 0.5 * (i1_l[k] + i2_l[k]);
 		
 		double d  = pixelDistance(i1_r[k], i1_g[k], i1_b[k], i2_r[k], i2_g[k], i2_b[k]);
@@ -83,6 +77,259 @@ int imageDiff(
 		o_g[k] = gray + green;
 		o_b[k] = o_r[k];
 	}
+}
+
+// NOTE: In unchanged pixels the distance is zero, and the output reduces to the luma.
+void copyLuma(int nPixels, const double *i_l, double *o_r, double *o_g, double *o_b) {
+	for (int k = 0; k < nPixels; k++)
+		o_r[k] = o_g[k] = o_b[k] = i_l[k];
+}
+
+uchar floatTo8bit(float f) {
+	if (f > 1.0f)
+		return 255;
+	else if (f < 0.0f)
+		return 0;
+	else
+		return (uchar)(255.0f*f + 0.5f);
+}
+
+class ByteDiffer {
+public:
+	ByteDiffer() {
+		for (int v = 0; v < 256; v++) {
+			lumaR[v] = LUMA_COEFF_R * (float)v / 255.0f;
+			lumaG[v] = LUMA_COEFF_G * (float)v / 255.0f;
+			lumaB[v] = LUMA_COEFF_B * (float)v / 255.0f;
+		}
+	}
+	
+	void diffPixels(
+		int nPixels,
+		const uchar *i1_r, const uchar *i1_g, const uchar *i1_b,
+		const uchar *i2_r, const uchar *i2_g, const uchar *i2_b,
+		uchar *o_rb, uchar *o_g) const
+	{
+		const float distScale = (float)(1.0 / (255.0 * SQRT3));
+		
+		for (int k = 0; k < nPixels; k++) {
+			float l1 = lumaR[i1_r[k]] + lumaG[i1_g[k]] + lumaB[i1_b[k]];
+			float l2 = lumaR[i2_r[k]] + lumaG[i2_g[k]] + lumaB[i2_b[k]];
+			
+			int dr = (int)i2_r[k] - (int)i1_r[k];
+			int dg = (int)i2_g[k] - (int)i1_g[k];
+			int db = (int)i2_b[k] - (int)i1_b[k];
+			float d  = distScale * std::sqrt((float)(dr*dr + dg*dg + db*db));
+			float md = 1.0f - d;
+			
+			float gray = md * 0.5f * (l1 + l2);
+			o_rb[k] = floatTo8bit(gray + d*l2);
+			o_g[k]  = floatTo8bit(gray + d*l1);
+		}
+	}
+	
+	void lumaPixels(
+		int nPixels, const uchar *i_r, const uchar *i_g, const uchar *i_b,
+		uchar *o_rb, uchar *o_g) const
+	{
+		for (int k = 0; k < nPixels; k++)
+			o_rb[k] = o_g[k] = floatTo8bit(lumaR[i_r[k]] + lumaG[i_g[k]] + lumaB[i_b[k]]);
+	}
+	
+private:
+	float lumaR[256];
+	float lumaG[256];
+	float lumaB[256];
+};
+
+template<typename T>
+struct RowBand {
+	RowBand(int nPixels) : r(new T[nPixels]), g(new T[nPixels]), b(new T[nPixels]) {}
+	~RowBand() { delete[] r; delete[] g; delete[] b; }
+	T *r, *g, *b;
+};
+
+// NOTE: The changed tiles of each band are found by comparing the decoded source pixels as
+// they are read, so that no separate pass over the files is needed, and any pair of images
+// that can be read can be compared. Calls ops.diff on the pixels of changed tiles and ops.luma
+// on the rest.
+class TileMap {
+public:
+	explicit TileMap(int width) :
+		tilesX((width + DIFF_TILE_WIDTH - 1) / DIFF_TILE_WIDTH), changed(new uchar[tilesX]) {}
+	~TileMap() { delete[] changed; }
+	
+	template<typename T>
+	void mark(int width, int rows, const RowBand<T> &in1, const RowBand<T> &in2) {
+		for (int tx = 0; tx < tilesX; tx++) {
+			int x = tx * DIFF_TILE_WIDTH;
+			size_t bytes = sizeof(T) * ((width - x < DIFF_TILE_WIDTH) ? width - x : DIFF_TILE_WIDTH);
+			changed[tx] = 0;
+			
+			for (int row = 0; row < rows && !changed[tx]; row++) {
+				int k = width*row + x;
+				changed[tx] =
+					std::memcmp(in1.r+k, in2.r+k, bytes) != 0 ||
+					std::memcmp(in1.g+k, in2.g+k, bytes) != 0 ||
+					std::memcmp(in1.b+k, in2.b+k, bytes) != 0;
+			}
+		}
+	}
+	
+	template<typename Ops>
+	void apply(int width, int rows, const Ops &ops) const {
+		for (int row = 0; row < rows; row++) {
+			for (int tx = 0; tx < tilesX; tx++) {
+				int x = tx * DIFF_TILE_WIDTH;
+				int k = width*row + x;
+				int n = (width - x < DIFF_TILE_WIDTH) ? width - x : DIFF_TILE_WIDTH;
+				
+				if (changed[tx])
+					ops.diff(k, n);
+				else
+					ops.luma(k, n);
+			}
+		}
+	}
+	
+private:
+	TileMap(const TileMap &);
+	TileMap &operator=(const TileMap &);
+	
+	int tilesX;
+	uchar *changed;
+};
+
+struct DoubleBandOps {
+	DoubleBandOps(
+		const RowBand<double> &in1, const RowBand<double> &in2,
+		double *i1_l, const double *i2_l, RowBand<double> &out) :
+		in1(in1), in2(in2), i1_l(i1_l), i2_l(i2_l), out(out) {}
+	
+	void diff(int k, int n) const {
+		diffPixels(
+			n, in1.r+k, in1.g+k, in1.b+k, in2.r+k, in2.g+k, in2.b+k,
+			i1_l+k, i2_l+k, out.r+k, out.g+k, out.b+k);
+	}
+	
+	void luma(int k, int n) const {
+		copyLuma(n, i1_l+k, out.r+k, out.g+k, out.b+k);
+	}
+	
+	const RowBand<double> &in1, &in2;
+	double *i1_l;
+	const double *i2_l;
+	RowBand<double> &out;
+};
+
+struct FloatBandOps {
+	FloatBandOps(
+		const ByteDiffer &differ,
+		const RowBand<uchar> &in1, const RowBand<uchar> &in2, RowBand<uchar> &out) :
+		differ(differ), in1(in1), in2(in2), out(out) {}
+	
+	void diff(int k, int n) const {
+		differ.diffPixels(n, in1.r+k, in1.g+k, in1.b+k, in2.r+k, in2.g+k, in2.b+k, out.r+k, out.g+k);
+	}
+	
+	void luma(int k, int n) const {
+		differ.lumaPixels(n, in1.r+k, in1.g+k, in1.b+k, out.r+k, out.g+k);
+	}
+	
+	const ByteDiffer &differ;
+	const RowBand<uchar> &in1, &in2;
+	RowBand<uchar> &out;
+};
+
+int diffBandsDouble(
+	cg_image_reader *reader1, cg_image_reader *reader2, cg_image_writer *writer,
+	int width, int height)
+{
+	int res = CGRESULT_OK;
+	int bandPixels = width * DIFF_ROWS_PER_BAND;
+	RowBand<double> in1(bandPixels), in2(bandPixels), out(bandPixels);
+	TileMap tileMap(width);
+	double *i1_l = new double[bandPixels];
+	double *i2_l = new double[bandPixels];
+	
+	for (int y = 0; y < height && res == CGRESULT_OK; y += DIFF_ROWS_PER_BAND) {
+		int rows = (height - y < DIFF_ROWS_PER_BAND) ? height - y : DIFF_ROWS_PER_BAND;
+		int nPixels = width * rows;
+		int one = 1;
+		
+		graphics_readImageRows(reader1, &rows, in1.r, in1.g, in1.b, 0, &res);
+		if (res != CGRESULT_OK)
+			break;
+		
+		graphics_readImageRows(reader2, &rows, in2.r, in2.g, in2.b, 0, &res);
+		if (res != CGRESULT_OK)
+			break;
+		
+		graphics_convertRGBtoHCL(&nPixels, &one, in1.r, in1.g, in1.b, 0, 0, i1_l, &res);
+		graphics_convertRGBtoHCL(&nPixels, &one, in2.r, in2.g, in2.b, 0, 0, i2_l, &res);
+		
+		tileMap.mark(width, rows, in1, in2);
+		tileMap.apply(width, rows, DoubleBandOps(in1, in2, i1_l, i2_l, out));
+		
+		graphics_writeImageRows(writer, &rows, out.r, out.g, out.b, 0, &res);
+	}
+	
+	delete[] i1_l;
+	delete[] i2_l;
+	return res;
+}
+
+int diffBandsFloat(
+	cg_image_reader *reader1, cg_image_reader *reader2, cg_image_writer *writer,
+	int width, int height)
+{
+	int res = CGRESULT_OK;
+	int bandPixels = width * DIFF_ROWS_PER_BAND;
+	RowBand<uchar> in1(bandPixels), in2(bandPixels), out(bandPixels);
+	TileMap tileMap(width);
+	ByteDiffer differ;
+	
+	for (int y = 0; y < height && res == CGRESULT_OK; y += DIFF_ROWS_PER_BAND) {
+		int rows = (height - y < DIFF_ROWS_PER_BAND) ? height - y : DIFF_ROWS_PER_BAND;
+		
+		graphics_readImageRows(reader1, &rows, in1.r, in1.g, in1.b, 0, &res);
+		if (res != CGRESULT_OK)
+			break;
+		
+		graphics_readImageRows(reader2, &rows, in2.r, in2.g, in2.b, 0, &res);
+		if (res != CGRESULT_OK)
+			break;
+		
+		tileMap.mark(width, rows, in1, in2);
+		tileMap.apply(width, rows, FloatBandOps(differ, in1, in2, out));
+		
+		graphics_writeImageRows(writer, &rows, out.r, out.g, out.r, 0, &res);
+	}
+	
+	return res;
+}
+
+}
+
+int imageDiff(
+	int nPixels,
+	const double *i1_r, const double *i1_g, const double *i1_b,
+	const double *i2_r, const double *i2_g, const double *i2_b,
+	double *o_r, double *o_g, double *o_b)
+{
+	int height = 1, res = -9999;
+	//double *i1_h = new double[nPixels];
+	//double *i1_c = new double[nPixels];
+	double *i1_l = new double[nPixels];
+	//double *i2_h = new double[nPixels];
+	//double *i2_c = new double[nPixels];
+	double *i2_l = new double[nPixels];
+	//graphics_convertRGBtoHCL(&nPixels, &height, i1_r, i1_g, i1_b, i1_h, i1_c, i1_l, &res);
+	//graphics_convertRGBtoHCL(&nPixels, &height, i2_r, i2_g, i2_b, i2_h, i2_c, i2_l, &res);
+	graphics_convertRGBtoHCL(&nPixels, &height, i1_r, i1_g, i1_b, 0, 0, i1_l, &res);
+	graphics_convertRGBtoHCL(&nPixels, &height, i2_r, i2_g, i2_b, 0, 0, i2_l, &res);
+	
+	diffPixels(nPixels, i1_r, i1_g, i1_b, i2_r, i2_g, i2_b, i1_l, i2_l, o_r, o_g, o_b);
 	
 	delete[] i1_l;
 	delete[] i2_l;
@@ -120,3 +367,49 @@ int imageDiff(
 	
 	return 0;
 }
+
+int imageDiffFiles(const char *path1, const char *path2, const char *outPath, int precision) {
+	int res = CGRESULT_UNSPECIFIED, closeRes;
+	int maxSize = 0x7fffffff;
+	int w1, h1, w2, h2;
+	int noAlpha = 0;
+	int dataFormat = (precision == DIFF_PRECISION_FLOAT) ?
+		CG_DATA_FORMAT_RGB_BYTES : CG_DATA_FORMAT_RGB;
+	cg_image_reader *reader1 = 0;
+	cg_image_reader *reader2 = 0;
+	cg_image_writer *writer = 0;
+	
+	graphics_openImageReader(path1, "bmp", &dataFormat, &maxSize, &maxSize, &reader1, &w1, &h1, &res);
+	if (res != CGRESULT_OK)
+		goto finish;
+	
+	graphics_openImageReader(path2, "bmp", &dataFormat, &maxSize, &maxSize, &reader2, &w2, &h2, &res);
+	if (res != CGRESULT_OK)
+		goto finish;
+	
+	if (w1 != w2 || h1 != h2) {
+		res = CGRESULT_UNSPECIFIED + CGRESULT_BAD_DIMENSION;
+		goto finish;
+	}
+	
+	graphics_openImageWriter(outPath, "bmp", &dataFormat, &w1, &h1, &noAlpha, &writer, &res);
+	if (res != CGRESULT_OK)
+		goto finish;
+	
+	if (precision == DIFF_PRECISION_FLOAT)
+		res = diffBandsFloat(reader1, reader2, writer, w1, h1);
+	else
+		res = diffBandsDouble(reader1, reader2, writer, w1, h1);
+	
+finish:
+	graphics_closeImageReader(reader1, &closeRes);
+	if (res == CGRESULT_OK)
+		res = closeRes;
+	graphics_closeImageReader(reader2, &closeRes);
+	if (res == CGRESULT_OK)
+		res = closeRes;
+	graphics_closeImageWriter(writer, &closeRes);
+	if (res == CGRESULT_OK)
+		res = closeRes;
+	return res;
+}
@@ -7,4 +7,15 @@ int imageDiff(
 	const double *i2_r, const double *i2_g, const double *i2_b,
 	double *o_r, double *o_g, double *o_b);
 
+enum {
+	DIFF_PRECISION_DOUBLE = 0,
+	DIFF_PRECISION_FLOAT  = 1
+};
+
+// Computes the same difference image as imageDiff, but streams the two source images and
+// the destination image a band of rows at a time instead of holding them in memory.
+// DIFF_PRECISION_DOUBLE gives output identical to imageDiff. DIFF_PRECISION_FLOAT works on
+// byte channels in single precision and may differ from it by one unit in the last place.
+int imageDiffFiles(const char *path1, const char *path2, const char *outPath, int precision);
+
 #endif
@@ -0,0 +1,203 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstddef>
+#include "graphdll.hpp"
+#include "context.hpp"
+
+namespace { // begin anonymous namespace
+
+// Data Definition
+// NOTE: The column sums are accumulated over strips of this many table columns, so that each
+// thread walks down its own strip along whole strip rows.
+const int STRIP_COLUMNS = 256;
+
+
+// Accumulator Types
+template<typename T> struct IntegralTraits {
+	typedef double Sum;
+};
+
+template<> struct IntegralTraits<uchar> {
+	typedef long long Sum;
+};
+
+
+// Table Construction
+// NOTE: The tables have (width + 1) x (height + 1) entries. The entry at (x, y) holds the sum
+// over all pixels left of x and below y, so the first row and column are zero. The table is
+// built in two parallel passes: prefix sums along each row, then running sums down each strip
+// of columns.
+template<typename T, typename Sum>
+void buildTable(int width, int height, const T *pixels, Sum *table, bool squared) {
+	size_t stride = (size_t)width + 1;
+	
+	for (size_t x = 0; x < stride; x++)
+		table[x] = 0;
+	
+	#pragma omp parallel for num_threads(contextThreads()) schedule(static)
+	for (int y = 0; y < height; y++) {
+		const T *p = pixels + (size_t)width * y;
+		Sum *row = table + stride * (y + 1);
+		Sum sum = 0;
+		
+		row[0] = 0;
+		if (squared) {
+			for (int x = 0; x < width; x++) {
+				sum += (Sum)p[x] * (Sum)p[x];
+				row[x+1] = sum;
+			}
+		}
+		else {
+			for (int x = 0; x < width; x++) {
+				sum += (Sum)p[x];
+				row[x+1] = sum;
+			}
+		}
+	}
+	
+	int strips = (int)((stride + STRIP_COLUMNS - 1) / STRIP_COLUMNS);
+	
+	#pragma omp parallel for num_threads(contextThreads()) schedule(static)
+	for (int s = 0; s < strips; s++) {
+		size_t x0 = (size_t)s * STRIP_COLUMNS;
+		size_t count = (x0 + STRIP_COLUMNS < stride) ? STRIP_COLUMNS : stride - x0;
+		
+		for (int y = 2; y <= height; y++) {
+			const Sum *above = table + stride * (y - 1) + x0;
+			Sum *row = table + stride * y + x0;
+			for (size_t x = 0; x < count; x++)
+				row[x] += above[x];
+		}
+	}
+}
+
+template<typename T, typename Sum>
+int buildIntegralImage(
+	const int *width, const int *height, const T *pixels, Sum *out_sums, Sum *out_squares)
+{
+	if (*width <= 0 || *height <= 0)
+		return CGRESULT_BAD_DIMENSION;
+	
+	buildTable(*width, *height, pixels, out_sums, false);
+	if (out_squares)
+		buildTable(*width, *height, pixels, out_squares, true);
+	
+	return CGRESULT_OK;
+}
+
+
+// Table Queries
+template<typename Sum>
+inline Sum rectSum(const Sum *table, size_t stride, int x, int y, int w, int h) {
+	const Sum *bottom = table + stride * y + x;
+	const Sum *top = bottom + stride * h;
+	return top[w] - top[0] - bottom[w] + bottom[0];
+}
+
+template<typename Sum>
+int queryIntegralImage(
+	const int *width, const int *height, const Sum *sums, const Sum *squares,
+	const int *rect_count, const int *rects,
+	double *out_sums, double *out_means, double *out_variances)
+{
+	int w = *width, h = *height, count = *rect_count;
+	size_t stride = (size_t)w + 1;
+	
+	if (w <= 0 || h <= 0)
+		return CGRESULT_BAD_DIMENSION;
+	else if (count < 0 || (out_variances && !squares))
+		return CGRESULT_INVALID_ARGUMENT;
+	
+	for (int i = 0; i < count; i++) {
+		const int *r = rects + 4*i;
+		if (r[0] < 0 || r[1] < 0 || r[2] <= 0 || r[3] <= 0 || r[2] > w - r[0] || r[3] > h - r[1])
+			return CGRESULT_BAD_DIMENSION;
+	}
+	
+	for (int i = 0; i < count; i++) {
+		const int *r = rects + 4*i;
+		double n = (double)r[2] * (double)r[3];
+		double sum = (double)rectSum(sums, stride, r[0], r[1], r[2], r[3]);
+		double mean = sum / n;
+		
+		if (out_sums)
+			out_sums[i] = sum;
+		if (out_means)
+			out_means[i] = mean;
+		if (out_variances) {
+			double var = (double)rectSum(squares, stride, r[0], r[1], r[2], r[3]) / n - mean*mean;
+			out_variances[i] = (var > 0.0) ? var : 0.0;
+		}
+	}
+	
+	return CGRESULT_OK;
+}
+
+} // end anonymous namespace
+
+
+// Public Interface
+void graphics_buildIntegralImage(
+	const int *width, const int *height, const double *pixels,
+	double *out_sums, double *out_squares,
+	int *out_result)
+{
+	*out_result = buildIntegralImage(width, height, pixels, out_sums, out_squares);
+}
+
+void graphics_buildIntegralImageBytes(
+	const int *width, const int *height, const uchar *pixels,
+	long long *out_sums, long long *out_squares,
+	int *out_result)
+{
+	*out_result = buildIntegralImage(width, height, pixels, out_sums, out_squares);
+}
+
+void graphics_queryIntegralImage(
+	const int *width, const int *height, const double *sums, const double *squares,
+	const int *rect_count, const int *rects,
+	double *out_sums, double *out_means, double *out_variances,
+	int *out_result)
+{
+	*out_result = queryIntegralImage(
+		width, height, sums, squares, rect_count, rects, out_sums, out_means, out_variances);
+}
+
+void graphics_queryIntegralImageBytes(
+	const int *width, const int *height, const long long *sums, const long long *squares,
+	const int *rect_count, const int *rects,
+	double *out_sums, double *out_means, double *out_variances,
+	int *out_result)
+{
+	*out_result = queryIntegralImage(
+		width, height, sums, squares, rect_count, rects, out_sums, out_means, out_variances);
+}
@@ -0,0 +1,268 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <cstddef>
+#include "graphdll.hpp"
+#include "context.hpp"
+
+namespace { // begin anonymous namespace
+
+// Data Definition
+const double SSIM_K1 = 0.01;
+const double SSIM_K2 = 0.03;
+
+// NOTE: Rows are processed in bands, so that each thread has a few bands to work on.
+const int BAND_ROWS = 64;
+
+
+// Helper Functions
+template<typename T> struct MetricTraits;
+
+template<> struct MetricTraits<double> {
+	typedef double Sum;
+	static double peak() { return 1.0; }
+};
+
+template<> struct MetricTraits<float> {
+	typedef double Sum;
+	static double peak() { return 1.0; }
+};
+
+// NOTE: Byte window sums are exact in 64-bit integers, so the running sums cannot drift.
+template<> struct MetricTraits<uchar> {
+	typedef long long Sum;
+	static double peak() { return 255.0; }
+};
+
+
+// Error Metrics
+template<typename T>
+void measureErrors(
+	int width, int height, const T *p1, const T *p2,
+	double &sumSquared, double &sumAbs, double &maxAbs)
+{
+	double sse = 0.0, sae = 0.0, mae = 0.0;
+	
+	#pragma omp parallel for num_threads(contextThreads()) schedule(static) \
+		reduction(+:sse,sae) reduction(max:mae)
+	for (int y = 0; y < height; y++) {
+		const T *row1 = p1 + (size_t)width * y;
+		const T *row2 = p2 + (size_t)width * y;
+		double rowSse = 0.0, rowSae = 0.0, rowMae = 0.0;
+		
+		#pragma omp simd reduction(+:rowSse,rowSae) reduction(max:rowMae)
+		for (int x = 0; x < width; x++) {
+			double d = (double)row1[x] - (double)row2[x];
+			double ad = std::fabs(d);
+			rowSse += d*d;
+			rowSae += ad;
+			rowMae = (ad > rowMae) ? ad : rowMae;
+		}
+		
+		sse += rowSse;
+		sae += rowSae;
+		mae = (rowMae > mae) ? rowMae : mae;
+	}
+	
+	sumSquared = sse;
+	sumAbs = sae;
+	maxAbs = mae;
+}
+
+
+// Structural Similarity
+// NOTE: The SSIM is computed over every window position of a uniform window of n x n pixels.
+// Each band keeps running column sums of x, y, x*x, y*y and x*y over the n rows of the current
+// window row, and slides a running window along them, so the cost per pixel is independent
+// of the window size (the one-dimensional form of a summed-area table). The window means of a
+// row are collected first, so that the SSIM formula itself can be evaluated in SIMD lanes.
+template<typename T>
+double ssimBand(
+	int width, int n, int y0, int y1, const T *p1, const T *p2,
+	double c1, double c2)
+{
+	typedef typename MetricTraits<T>::Sum Sum;
+	
+	Sum *colSums = new Sum[5 * (size_t)width];
+	Sum *sx = colSums, *sy = sx + width, *sxx = sy + width, *syy = sxx + width, *sxy = syy + width;
+	int windowCols = width - n + 1;
+	double *windowMeans = new double[5 * (size_t)windowCols];
+	double *mx = windowMeans, *my = mx + windowCols, *mxx = my + windowCols;
+	double *myy = mxx + windowCols, *mxy = myy + windowCols;
+	double invN = 1.0 / ((double)n * (double)n);
+	double total = 0.0;
+	
+	for (int x = 0; x < width; x++)
+		sx[x] = sy[x] = sxx[x] = syy[x] = sxy[x] = 0;
+	
+	for (int y = y0; y < y0 + n; y++) {
+		const T *row1 = p1 + (size_t)width * y;
+		const T *row2 = p2 + (size_t)width * y;
+		
+		#pragma omp simd
+		for (int x = 0; x < width; x++) {
+			Sum v1 = row1[x], v2 = row2[x];
+			sx[x] += v1; sy[x] += v2;
+			sxx[x] += v1*v1; syy[x] += v2*v2; sxy[x] += v1*v2;
+		}
+	}
+	
+	for (int y = y0; y < y1; y++) {
+		Sum wx = 0, wy = 0, wxx = 0, wyy = 0, wxy = 0;
+		
+		for (int x = 0; x < n; x++) {
+			wx += sx[x]; wy += sy[x]; wxx += sxx[x]; wyy += syy[x]; wxy += sxy[x];
+		}
+		
+		// Collect the window sums of the row, then evaluate the SSIM of all windows at once.
+		for (int x = 0; ; x++) {
+			mx[x] = invN * (double)wx;
+			my[x] = invN * (double)wy;
+			mxx[x] = invN * (double)wxx;
+			myy[x] = invN * (double)wyy;
+			mxy[x] = invN * (double)wxy;
+			
+			if (x + n >= width)
+				break;
+			
+			wx += sx[x+n] - sx[x]; wy += sy[x+n] - sy[x];
+			wxx += sxx[x+n] - sxx[x]; wyy += syy[x+n] - syy[x]; wxy += sxy[x+n] - sxy[x];
+		}
+		
+		double rowTotal = 0.0;
+		
+		#pragma omp simd reduction(+:rowTotal)
+		for (int x = 0; x < windowCols; x++) {
+			double mx2 = mx[x]*mx[x], my2 = my[x]*my[x], mxmy = mx[x]*my[x];
+			rowTotal +=
+				((2.0*mxmy + c1) * (2.0*(mxy[x] - mxmy) + c2)) /
+				((mx2 + my2 + c1) * ((mxx[x] - mx2) + (myy[x] - my2) + c2));
+		}
+		
+		total += rowTotal;
+		
+		// Slide the column sums down by one row.
+		if (y + 1 < y1) {
+			const T *add1 = p1 + (size_t)width * (y + n), *add2 = p2 + (size_t)width * (y + n);
+			const T *sub1 = p1 + (size_t)width * y,       *sub2 = p2 + (size_t)width * y;
+			
+			#pragma omp simd
+			for (int x = 0; x < width; x++) {
+				Sum a1 = add1[x], a2 = add2[x], s1 = sub1[x], s2 = sub2[x];
+				sx[x] += a1 - s1; sy[x] += a2 - s2;
+				sxx[x] += a1*a1 - s1*s1; syy[x] += a2*a2 - s2*s2; sxy[x] += a1*a2 - s1*s2;
+			}
+		}
+	}
+	
+	delete[] colSums;
+	delete[] windowMeans;
+	return total;
+}
+
+template<typename T>
+double measureSSIM(int width, int height, const T *p1, const T *p2, int window) {
+	int n = window;
+	if (n > width)  { n = width; }
+	if (n > height) { n = height; }
+	
+	double peak = MetricTraits<T>::peak();
+	double c1 = (SSIM_K1 * peak) * (SSIM_K1 * peak);
+	double c2 = (SSIM_K2 * peak) * (SSIM_K2 * peak);
+	
+	int windowRows = height - n + 1;
+	int windowCols = width - n + 1;
+	int bands = (windowRows + BAND_ROWS - 1) / BAND_ROWS;
+	double total = 0.0;
+	
+	#pragma omp parallel for num_threads(contextThreads()) schedule(dynamic) reduction(+:total)
+	for (int band = 0; band < bands; band++) {
+		int y0 = band * BAND_ROWS;
+		int y1 = (y0 + BAND_ROWS < windowRows) ? y0 + BAND_ROWS : windowRows;
+		total += ssimBand(width, n, y0, y1, p1, p2, c1, c2);
+	}
+	
+	return total / ((double)windowRows * (double)windowCols);
+}
+
+template<typename T>
+int measureDifference(
+	const int *width, const int *height, const T *p1, const T *p2, const int *ssim_window,
+	double *out_metrics)
+{
+	if (*width <= 0 || *height <= 0 || *ssim_window < 0)
+		return CGRESULT_INVALID_ARGUMENT;
+	
+	double sumSquared, sumAbs, maxAbs;
+	measureErrors(*width, *height, p1, p2, sumSquared, sumAbs, maxAbs);
+	
+	double totalPixels = (double)*width * (double)*height;
+	double mse = sumSquared / totalPixels;
+	double peak = MetricTraits<T>::peak();
+	
+	out_metrics[CG_METRIC_MSE] = mse;
+	out_metrics[CG_METRIC_PSNR] = (mse > 0.0) ? 10.0 * std::log10(peak*peak / mse) : HUGE_VAL;
+	out_metrics[CG_METRIC_MAX_ABS_ERROR] = maxAbs;
+	out_metrics[CG_METRIC_MEAN_ABS_ERROR] = sumAbs / totalPixels;
+	out_metrics[CG_METRIC_SSIM] =
+		(*ssim_window > 0) ? measureSSIM(*width, *height, p1, p2, *ssim_window) : 0.0;
+	
+	return CGRESULT_OK;
+}
+
+} // end anonymous namespace
+
+
+// Public Interface
+void graphics_measureDifference(
+	const int *width, const int *height, const double *p1, const double *p2,
+	const int *ssim_window, double *out_metrics,
+	int *out_result)
+{
+	*out_result = measureDifference(width, height, p1, p2, ssim_window, out_metrics);
+}
+
+void graphics_measureDifferenceFloat(
+	const int *width, const int *height, const float *p1, const float *p2,
+	const int *ssim_window, double *out_metrics,
+	int *out_result)
+{
+	*out_result = measureDifference(width, height, p1, p2, ssim_window, out_metrics);
+}
+
+void graphics_measureDifferenceBytes(
+	const int *width, const int *height, const uchar *p1, const uchar *p2,
+	const int *ssim_window, double *out_metrics,
+	int *out_result)
+{
+	*out_result = measureDifference(width, height, p1, p2, ssim_window, out_metrics);
+}
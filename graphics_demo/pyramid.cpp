@@ -0,0 +1,194 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "graphdll.hpp"
+
+namespace { // begin anonymous namespace
+
+// Pyramid Levels
+// NOTE: Each level keeps the sums of one pending pair of rows from the level above it. When a
+// pair is complete (or the level above ends with an odd row), the averaged row is written to
+// the level's file and passed on to the next level, so only a couple of rows per level are
+// in memory at any time. At odd widths and heights, the last pixels are averaged alone.
+struct PyramidLevel {
+	PyramidLevel() : width(0), height(0), srcWidth(0), srcHeight(0), srcRows(0), writer(0) {}
+	
+	int width, height;
+	int srcWidth, srcHeight;
+	int srcRows;
+	cg_image_writer *writer;
+	std::vector<unsigned int> sums;
+	std::vector<uchar> row;
+};
+
+int feedLevel(
+	std::vector<PyramidLevel> &levels, size_t index, int withAlpha,
+	const uchar *r, const uchar *g, const uchar *b, const uchar *a)
+{
+	if (index >= levels.size())
+		return CGRESULT_OK;
+	
+	PyramidLevel &level = levels[index];
+	unsigned int *sums = &level.sums[0];
+	int srcY = level.srcRows++;
+	
+	for (int x = 0; x < level.srcWidth; x++) {
+		unsigned int *sum = sums + 4*(x/2);
+		sum[0] += r[x];
+		sum[1] += g[x];
+		sum[2] += b[x];
+		sum[3] += a[x];
+	}
+	
+	if (srcY % 2 == 0 && srcY != level.srcHeight - 1)
+		return CGRESULT_OK; // Wait for the second row of the pair.
+	
+	int rows = (srcY % 2 == 0) ? 1 : 2;
+	int width = level.width;
+	uchar *outR = &level.row[0], *outG = outR + width, *outB = outG + width, *outA = outB + width;
+	
+	for (int x = 0; x < width; x++) {
+		unsigned int n = rows * ((2*x + 1 < level.srcWidth) ? 2 : 1);
+		unsigned int *sum = sums + 4*x;
+		outR[x] = (uchar)((sum[0] + n/2) / n);
+		outG[x] = (uchar)((sum[1] + n/2) / n);
+		outB[x] = (uchar)((sum[2] + n/2) / n);
+		outA[x] = (uchar)((sum[3] + n/2) / n);
+	}
+	
+	std::memset(sums, 0, 4 * width * sizeof(unsigned int));
+	
+	int res, one = 1;
+	graphics_writeImageRows(level.writer, &one, outR, outG, outB, (withAlpha) ? outA : 0, &res);
+	if (res != CGRESULT_OK)
+		return res;
+	
+	return feedLevel(levels, index + 1, withAlpha, outR, outG, outB, outA);
+}
+
+int buildPyramid(
+	const char *fileName, const char *fileType, const char *outFileBase, const char *outFileType,
+	int maxLevels, int withAlpha, int &levelsBuilt)
+{
+	int res = CGRESULT_OK, closeRes;
+	int maxSize = 0x7fffffff;
+	int dataFormat = CG_DATA_FORMAT_RGB_BYTES;
+	int width, height;
+	cg_image_reader *reader = 0;
+	std::vector<PyramidLevel> levels;
+	std::vector<uchar> srcRow;
+	
+	levelsBuilt = 0;
+	
+	graphics_openImageReader(
+		fileName, fileType, &dataFormat, &maxSize, &maxSize, &reader, &width, &height, &res);
+	if (res != CGRESULT_OK)
+		return res;
+	
+	// Set up the levels, down to 1 x 1 pixels at most.
+	for (int w = width, h = height; (int)levels.size() < maxLevels && (w > 1 || h > 1); ) {
+		PyramidLevel level;
+		level.srcWidth = w;
+		level.srcHeight = h;
+		level.width = w = (w + 1) / 2;
+		level.height = h = (h + 1) / 2;
+		level.sums.assign(4 * (size_t)w, 0);
+		level.row.resize(4 * (size_t)w);
+		levels.push_back(level);
+	}
+	
+	// NOTE: The levels are written as BMP files if no type is given.
+	if (!outFileType || !*outFileType)
+		outFileType = "bmp";
+	
+	for (size_t k = 0; k < levels.size(); k++) {
+		char suffix[32];
+		std::sprintf(suffix, "_%d.", (int)k + 1);
+		std::string path = std::string(outFileBase) + suffix + outFileType;
+		
+		graphics_openImageWriter(
+			path.c_str(), outFileType, &dataFormat, &levels[k].width, &levels[k].height, &withAlpha,
+			&levels[k].writer, &res);
+		if (res != CGRESULT_OK)
+			goto finish;
+	}
+	
+	srcRow.resize(4 * (size_t)width);
+	
+	for (int y = 0; y < height && res == CGRESULT_OK; y++) {
+		uchar *r = &srcRow[0], *g = r + width, *b = g + width, *a = b + width;
+		int one = 1;
+		
+		graphics_readImageRows(reader, &one, r, g, b, a, &res);
+		if (res == CGRESULT_OK)
+			res = feedLevel(levels, 0, withAlpha, r, g, b, a);
+	}
+	
+finish:
+	graphics_closeImageReader(reader, &closeRes);
+	if (res == CGRESULT_OK)
+		res = closeRes;
+	
+	for (size_t k = 0; k < levels.size(); k++) {
+		graphics_closeImageWriter(levels[k].writer, &closeRes);
+		if (res == CGRESULT_OK)
+			res = closeRes;
+	}
+	
+	if (res == CGRESULT_OK)
+		levelsBuilt = (int)levels.size();
+	
+	return res;
+}
+
+} // end anonymous namespace
+
+
+// Public Interface
+void graphics_buildImagePyramid(
+	const char *file_name, const char *file_type,
+	const char *out_file_base, const char *out_file_type,
+	const int *max_levels, const int *with_alpha,
+	int *out_levels,
+	int *out_result)
+{
+	if (*max_levels < 0) {
+		*out_result = CGRESULT_INVALID_ARGUMENT;
+		return;
+	}
+	
+	*out_result = buildPyramid(
+		file_name, file_type, out_file_base, out_file_type, *max_levels, *with_alpha, *out_levels);
+}
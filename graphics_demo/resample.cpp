@@ -0,0 +1,381 @@
+
+/*
+Copyright (c) 2026, Johan Sarge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+	
+	1. Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+	
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+	
+	3. Neither the name of the copyright holder nor the names of its contributors
+	may be used to endorse or promote products derived from this software without
+	specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <cstddef>
+#include "graphdll.hpp"
+#include "context.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CG_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace { // begin anonymous namespace
+
+// Data Definition
+const double PI = 3.14159265358979323846;
+
+// NOTE: Each thread produces a contiguous band of output rows, of at least BAND_ROWS rows, and
+// keeps the horizontally resampled source rows in a ring of one row per vertical tap, so that
+// each source row is resampled once per band and the intermediate rows stay in cache.
+const int BAND_ROWS = 32;
+
+
+// Filter Kernels
+double bilinearKernel(double x) {
+	x = std::fabs(x);
+	return (x < 1.0) ? 1.0 - x : 0.0;
+}
+
+// NOTE: This is the Catmull-Rom spline (the Keys kernel with a = -0.5).
+double bicubicKernel(double x) {
+	x = std::fabs(x);
+	if (x < 1.0)
+		return (1.5*x - 2.5)*x*x + 1.0;
+	else if (x < 2.0)
+		return ((-0.5*x + 2.5)*x - 4.0)*x + 2.0;
+	else
+		return 0.0;
+}
+
+double sinc(double x) {
+	if (x == 0.0)
+		return 1.0;
+	x *= PI;
+	return std::sin(x) / x;
+}
+
+double lanczos3Kernel(double x) {
+	return (std::fabs(x) < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+typedef double (*Kernel)(double x);
+
+
+// Filter Weights
+// NOTE: The taps of every output pixel cover a contiguous window of source pixels. Taps that
+// fall outside the source are folded onto the edge pixels, and all windows are padded with
+// zero weights to the same number of taps, so that the inner loops have a fixed length. The
+// weights are stored in the precision of the accumulators. The horizontal weights are stored
+// tap-major (weight k of pixel i at k*dstSize + i), so that a vector of output pixels loads
+// each of its taps contiguously, and the vertical weights pixel-major (at i*taps + k).
+template<typename W>
+struct Weights {
+	Weights(int srcSize, int dstSize, Kernel kernel, double radius, bool tapMajor);
+	~Weights() { delete[] first; delete[] weights; }
+	
+	int taps;
+	int *first;
+	W *weights;
+};
+
+template<typename W>
+Weights<W>::Weights(int srcSize, int dstSize, Kernel kernel, double radius, bool tapMajor) {
+	double scale = (double)srcSize / (double)dstSize;
+	double filterScale = (scale > 1.0) ? scale : 1.0;
+	double support = radius * filterScale;
+	
+	taps = (int)std::ceil(2.0 * support) + 1;
+	if (taps > srcSize)
+		taps = srcSize;
+	
+	first = new int[dstSize];
+	weights = new W[(size_t)dstSize * taps];
+	double *window = new double[taps];
+	
+	for (int i = 0; i < dstSize; i++) {
+		double center = (i + 0.5) * scale - 0.5;
+		int left = (int)std::ceil(center - support);
+		int right = (int)std::floor(center + support);
+		
+		int start = (left < 0) ? 0 : left;
+		if (start + taps > srcSize)
+			start = srcSize - taps;
+		
+		for (int k = 0; k < taps; k++)
+			window[k] = 0.0;
+		
+		double total = 0.0;
+		for (int j = left; j <= right; j++) {
+			double w = kernel((j - center) / filterScale);
+			int clamped = (j < 0) ? 0 : (j >= srcSize) ? srcSize - 1 : j;
+			int k = clamped - start;
+			if (k < 0)     { k = 0; }
+			if (k >= taps) { k = taps - 1; }
+			window[k] += w;
+			total += w;
+		}
+		
+		first[i] = start;
+		for (int k = 0; k < taps; k++) {
+			size_t index = (tapMajor) ? (size_t)k * dstSize + i : (size_t)i * taps + k;
+			weights[index] = (W)((total != 0.0) ? window[k] / total : 0.0);
+		}
+	}
+	
+	delete[] window;
+}
+
+
+// Horizontal Resampling
+// NOTE: Byte rows are widened to floats first, so that all the kernels work on rows of the
+// accumulator type. The AVX2 kernels gather the taps of 8 (or 4) output pixels at a time, and
+// add them up in the same order as the scalar kernel, so the results are identical.
+template<typename Acc>
+void resampleRowScalar(int dstWidth, const Weights<Acc> &wx, const Acc *src, Acc *dst, int x) {
+	for (; x < dstWidth; x++) {
+		const Acc *s = src + wx.first[x];
+		const Acc *w = wx.weights + x;
+		Acc sum = 0;
+		for (int k = 0; k < wx.taps; k++, w += dstWidth)
+			sum += s[k] * *w;
+		dst[x] = sum;
+	}
+}
+
+#ifdef CG_X86_SIMD
+__attribute__ ((target ("avx2")))
+void resampleRowAVX2(int dstWidth, const Weights<float> &wx, const float *src, float *dst) {
+	const __m256i one = _mm256_set1_epi32(1);
+	int x = 0;
+	
+	for (; x + 8 <= dstWidth; x += 8) {
+		__m256i index = _mm256_loadu_si256((const __m256i*)(wx.first + x));
+		const float *w = wx.weights + x;
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < wx.taps; k++, w += dstWidth) {
+			__m256 s = _mm256_i32gather_ps(src, index, 4);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(s, _mm256_loadu_ps(w)));
+			index = _mm256_add_epi32(index, one);
+		}
+		_mm256_storeu_ps(dst + x, sum);
+	}
+	
+	resampleRowScalar(dstWidth, wx, src, dst, x);
+}
+
+__attribute__ ((target ("avx2")))
+void resampleRowAVX2(int dstWidth, const Weights<double> &wx, const double *src, double *dst) {
+	const __m128i one = _mm_set1_epi32(1);
+	int x = 0;
+	
+	for (; x + 4 <= dstWidth; x += 4) {
+		__m128i index = _mm_loadu_si128((const __m128i*)(wx.first + x));
+		const double *w = wx.weights + x;
+		__m256d sum = _mm256_setzero_pd();
+		for (int k = 0; k < wx.taps; k++, w += dstWidth) {
+			__m256d s = _mm256_i32gather_pd(src, index, 8);
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(s, _mm256_loadu_pd(w)));
+			index = _mm_add_epi32(index, one);
+		}
+		_mm256_storeu_pd(dst + x, sum);
+	}
+	
+	resampleRowScalar(dstWidth, wx, src, dst, x);
+}
+#endif
+
+template<typename Acc>
+void resampleRow(int dstWidth, const Weights<Acc> &wx, const Acc *src, Acc *dst, bool avx2) {
+#ifdef CG_X86_SIMD
+	if (avx2) {
+		resampleRowAVX2(dstWidth, wx, src, dst);
+		return;
+	}
+#endif
+	resampleRowScalar(dstWidth, wx, src, dst, 0);
+}
+
+bool selectAVX2() {
+#ifdef CG_X86_SIMD
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+
+// Resampling
+template<typename T> struct SampleTraits {
+	typedef float Acc;
+	static const float *widen(const T *src, int, float *) { return src; }
+	static T store(float v) { return (T)v; }
+};
+
+template<> struct SampleTraits<double> {
+	typedef double Acc;
+	static const double *widen(const double *src, int, double *) { return src; }
+	static double store(double v) { return v; }
+};
+
+template<> struct SampleTraits<uchar> {
+	typedef float Acc;
+	static const float *widen(const uchar *src, int count, float *buffer) {
+		for (int i = 0; i < count; i++)
+			buffer[i] = (float)src[i];
+		return buffer;
+	}
+	static uchar store(float v) {
+		return (v <= 0.0f) ? 0 : (v >= 255.0f) ? 255 : (uchar)(v + 0.5f);
+	}
+};
+
+template<typename T>
+void resampleBand(
+	int srcWidth, const T *src, int dstWidth, T *dst, int y0, int y1,
+	const Weights<typename SampleTraits<T>::Acc> &wx,
+	const Weights<typename SampleTraits<T>::Acc> &wy, bool avx2)
+{
+	typedef typename SampleTraits<T>::Acc Acc;
+	int taps = wy.taps;
+	Acc *ring = new Acc[(size_t)taps * dstWidth];
+	Acc *sum = new Acc[dstWidth];
+	Acc *widened = new Acc[srcWidth];
+	int next = wy.first[y0]; // The next source row to resample.
+	
+	for (int y = y0; y < y1; y++) {
+		int first = wy.first[y];
+		if (next < first)
+			next = first;
+		
+		// Resample the new source rows of the window horizontally.
+		for (; next < first + taps; next++) {
+			const Acc *row = SampleTraits<T>::widen(src + (size_t)srcWidth * next, srcWidth, widened);
+			resampleRow(dstWidth, wx, row, ring + (size_t)dstWidth * (next % taps), avx2);
+		}
+		
+		// Combine them vertically, a whole output row at a time.
+		const Acc *w = wy.weights + (size_t)y * taps;
+		T *out = dst + (size_t)dstWidth * y;
+		
+		for (int x = 0; x < dstWidth; x++)
+			sum[x] = 0;
+		
+		for (int k = 0; k < taps; k++) {
+			Acc wk = w[k];
+			const Acc *row = ring + (size_t)dstWidth * ((first + k) % taps);
+			for (int x = 0; x < dstWidth; x++)
+				sum[x] += wk * row[x];
+		}
+		
+		for (int x = 0; x < dstWidth; x++)
+			out[x] = SampleTraits<T>::store(sum[x]);
+	}
+	
+	delete[] ring;
+	delete[] sum;
+	delete[] widened;
+}
+
+template<typename T>
+int resample(
+	const int *src_width, const int *src_height, const T *src,
+	const int *dst_width, const int *dst_height, T *dst,
+	const int *filter)
+{
+	int srcWidth = *src_width, srcHeight = *src_height;
+	int dstWidth = *dst_width, dstHeight = *dst_height;
+	
+	if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0)
+		return CGRESULT_BAD_DIMENSION;
+	
+	Kernel kernel;
+	double radius;
+	
+	switch (*filter) {
+	case CG_FILTER_BILINEAR:
+		kernel = bilinearKernel;
+		radius = 1.0;
+		break;
+	case CG_FILTER_BICUBIC:
+		kernel = bicubicKernel;
+		radius = 2.0;
+		break;
+	case CG_FILTER_LANCZOS3:
+		kernel = lanczos3Kernel;
+		radius = 3.0;
+		break;
+	default:
+		return CGRESULT_INVALID_ARGUMENT;
+	}
+	
+	typedef typename SampleTraits<T>::Acc Acc;
+	Weights<Acc> wx(srcWidth, dstWidth, kernel, radius, true);
+	Weights<Acc> wy(srcHeight, dstHeight, kernel, radius, false);
+	bool avx2 = selectAVX2();
+	
+	int threads = contextThreads();
+	int bandRows = (dstHeight + threads - 1) / threads;
+	if (bandRows < BAND_ROWS)
+		bandRows = BAND_ROWS;
+	int bands = (dstHeight + bandRows - 1) / bandRows;
+	
+	#pragma omp parallel for num_threads(threads)
+	for (int band = 0; band < bands; band++) {
+		int y0 = band * bandRows;
+		int y1 = (y0 + bandRows < dstHeight) ? y0 + bandRows : dstHeight;
+		resampleBand(srcWidth, src, dstWidth, dst, y0, y1, wx, wy, avx2);
+	}
+	
+	return CGRESULT_OK;
+}
+
+} // end anonymous namespace
+
+
+// Public Interface
+void graphics_resample(
+	const int *src_width, const int *src_height, const double *src,
+	const int *dst_width, const int *dst_height, double *dst,
+	const int *filter,
+	int *out_result)
+{
+	*out_result = resample(src_width, src_height, src, dst_width, dst_height, dst, filter);
+}
+
+void graphics_resampleFloat(
+	const int *src_width, const int *src_height, const float *src,
+	const int *dst_width, const int *dst_height, float *dst,
+	const int *filter,
+	int *out_result)
+{
+	*out_result = resample(src_width, src_height, src, dst_width, dst_height, dst, filter);
+}
+
+void graphics_resampleBytes(
+	const int *src_width, const int *src_height, const uchar *src,
+	const int *dst_width, const int *dst_height, uchar *dst,
+	const int *filter,
+	int *out_result)
+{
+	*out_result = resample(src_width, src_height, src, dst_width, dst_height, dst, filter);
+}